@@ -0,0 +1,132 @@
+/*
+ * Push/pop throughput and tail latency of the lock backend the benchmark
+ * is built with (see CIRCBUF_LOCK), from one thread up to the number
+ * given.
+ *
+ * Each thread pushes the string and pops one back in a loop, timing
+ * every operation. Aggregate throughput and the latency percentiles of
+ * all the operations are reported per thread count. Without the lock
+ * backend only one thread is run.
+ *
+ * Usage: bench_lock [max threads [operations per thread [string size]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <circstringbuf.h>
+
+#define BUFFER_SIZE (1024 * 1024)
+
+#if !defined(CIRCBUF_LOCK)
+#	define CIRCBUF_LOCK CIRCBUF_LOCK_NONE
+#endif
+
+static const char *backends[] = {"none", "mutex", "ticket", "adaptive"};
+
+static circstringbuf_t cb;
+static size_t operations = 100000;
+static size_t string_size = 64;
+
+static unsigned long
+now(void) {
+struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+static int
+compare(const void *a, const void *b) {
+unsigned long x = *(const unsigned long *)a;
+unsigned long y = *(const unsigned long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * push and pop strings, storing the latency of each operation in ns
+ */
+static void *
+worker(void *arg) {
+unsigned long *latency = arg;
+char *string = malloc(string_size + 1);
+char *popped = malloc(string_size + 1);
+
+	memset(string, 'x', string_size);
+	string[string_size] = '\0';
+	for (size_t i = 0; i < operations; i++) {
+
+unsigned long start = now();
+
+		circstringbuf_push(&cb, string);
+
+unsigned long pushed = now();
+
+		circstringbuf_pop(&cb, popped);
+		latency[2 * i] = pushed - start;
+		latency[2 * i + 1] = now() - pushed;
+	}
+	free(string);
+	free(popped);
+
+	return NULL;
+}
+
+static void
+run(int threads, unsigned long *latency) {
+pthread_t thread[threads];
+size_t total = 2 * operations * threads;
+
+	circstringbuf_reset(&cb);
+
+unsigned long start = now();
+
+	for (int i = 0; i < threads; i++)
+		pthread_create(&thread[i], NULL, worker,
+			latency + 2 * operations * i);
+	for (int i = 0; i < threads; i++)
+		pthread_join(thread[i], NULL);
+
+double elapsed = (now() - start) / 1e9;
+
+	qsort(latency, total, sizeof(*latency), compare);
+	printf("%-8s %3d threads %8.2f Mops/s  p50 %6lu ns  p99 %6lu ns"
+		"  p99.9 %7lu ns\n", backends[CIRCBUF_LOCK], threads,
+		total / elapsed / 1e6, latency[total / 2],
+		latency[total * 99 / 100], latency[total * 999 / 1000]);
+}
+
+int
+main(int argc, char **argv) {
+int threads = (argc > 1) ? atoi(argv[1]) : 8;
+
+	if (argc > 2)
+		operations = atol(argv[2]);
+	if (argc > 3)
+		string_size = atol(argv[3]);
+	if (CIRCBUF_LOCK == CIRCBUF_LOCK_NONE)
+		threads = 1;
+
+unsigned long *latency = malloc(2 * operations * threads * sizeof(*latency));
+
+	if (!latency || threads < 1 || circstringbuf_create(&cb, BUFFER_SIZE,
+		CIRCBUF_NODE_ANY, 0) != CIRCBUF_OK) {
+
+		fprintf(stderr, "allocation failed\n");
+
+		return 1;
+	}
+
+	for (int n = 1; n <= threads; n *= 2)
+		run(n, latency);
+
+	circstringbuf_destroy(&cb);
+	free(latency);
+
+	return 0;
+}
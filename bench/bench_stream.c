@@ -0,0 +1,129 @@
+/*
+ * Effect of streaming stores in circstringbuf_push() on a co-running
+ * cache-sensitive workload.
+ *
+ * The workload chases pointers through the working set sized to stay in
+ * the cache, while the logger pushes long strings into the big buffer
+ * nobody reads. Workload throughput is reported with no logger, with
+ * strings copied as usual and with streaming stores.
+ *
+ * Usage: bench_stream [seconds [working set KiB [string size]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <circstringbuf.h>
+
+#define BUFFER_SIZE (256 * 1024 * 1024)
+
+static circstringbuf_t cb;
+static volatile int running;
+static size_t string_size = 1024;
+
+static double
+now(void) {
+struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *
+logger(void *arg) {
+char *string = malloc(string_size + 1);
+unsigned long *pushed = arg;
+
+	memset(string, 'x', string_size);
+	string[string_size] = '\0';
+	while (running) {
+
+		circstringbuf_push(&cb, string);
+		(*pushed)++;
+	}
+	free(string);
+
+	return NULL;
+}
+
+/*
+ * run the workload for the time given, with the logger pushing strings
+ * if asked to, streaming ones of threshold size and longer
+ */
+static void
+run(const char *name, double seconds, size_t *chain, size_t threshold,
+	bool log) {
+pthread_t thread;
+unsigned long pushed = 0, steps = 0;
+size_t position = 0;
+
+	circstringbuf_set_streaming(&cb, threshold);
+	running = 1;
+	if (log)
+		pthread_create(&thread, NULL, logger, &pushed);
+
+double start = now(), elapsed;
+
+	do {
+
+		for (int i = 0; i < 100000; i++)
+			position = chain[position];
+		steps += 100000;
+	} while ((elapsed = now() - start) < seconds);
+
+	running = 0;
+	if (log)
+		pthread_join(thread, NULL);
+
+	printf("%-12s workload %8.1f Msteps/s  logger %8.1f MB/s  (%zu)\n",
+		name, steps / elapsed / 1e6,
+		pushed * (string_size + 1) / elapsed / 1e6, position);
+}
+
+int
+main(int argc, char **argv) {
+double seconds = (argc > 1) ? atof(argv[1]) : 2;
+size_t working_set = ((argc > 2) ? atol(argv[2]) : 1024) * 1024;
+size_t count = working_set / sizeof(size_t);
+size_t *chain = malloc(working_set);
+
+	if (argc > 3)
+		string_size = atol(argv[3]);
+
+	if (!chain || count < 2 ||
+		circstringbuf_create(&cb, BUFFER_SIZE, CIRCBUF_NODE_ANY,
+		CIRCBUF_PREFAULT) != CIRCBUF_OK) {
+
+		fprintf(stderr, "allocation failed\n");
+
+		return 1;
+	}
+
+	/*
+	 * Random cyclic permutation, so each step misses if the working set
+	 * is evicted.
+	 */
+	for (size_t i = 0; i < count; i++)
+		chain[i] = i;
+	for (size_t i = count - 1; i > 0; i--) {
+
+size_t j = rand() % i;
+size_t t = chain[i];
+
+		chain[i] = chain[j];
+		chain[j] = t;
+	}
+
+	run("no logger", seconds, chain, 0, false);
+	run("cached", seconds, chain, 0, true);
+	run("streaming", seconds, chain, 64, true);
+
+	circstringbuf_destroy(&cb);
+	free(chain);
+
+	return 0;
+}
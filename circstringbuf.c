@@ -21,9 +21,440 @@
  */
 
 #include <string.h>
+#include <time.h>
 
 #include "circstringbuf.h"
 
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#endif /* defined(__SSE2__) */
+
+#if defined(CIRCBUF_POSIX)
+#	include <signal.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	if defined(__linux__)
+#		include <sys/syscall.h>
+#	endif /* defined(__linux__) */
+#endif /* defined(CIRCBUF_POSIX) */
+
+#define CIRCBUF_SEQ_STORE(__seq, __value) \
+	__atomic_store_n(&(__seq), (__value), __ATOMIC_RELEASE)
+
+/*
+ * number of bytes occupied by the strings stored in the buffer
+ */
+static inline size_t
+circstringbuf_used(const circstringbuf_t *cb) {
+
+	return cb->end - (CIRCBUF_SPACE_LEFT(cb->empty, cb->current_end,
+		cb->current_start, cb->end));
+}
+
+/*
+ * publish the new buffer start to lock-free readers
+ *
+ * AI: MUST BE CALLED BEFORE THE BYTES RELEASED ARE OVERWRITTEN -- the fence
+ *     orders the counter update before the following data stores
+ */
+static inline void
+circstringbuf_seq_start(circstringbuf_t *cb, size_t used) {
+
+	CIRCBUF_SEQ_STORE(cb->seq_start, cb->seq_end - used);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/*
+ * realign sequence counters after the data was moved inside the buffer
+ *
+ * Both counters are advanced to the next multiple of the buffer size, so
+ * everything readers could have copied so far is considered evicted.
+ * Returns the buffer end sequence before.
+ */
+static inline uint64_t
+circstringbuf_seq_invalidate(circstringbuf_t *cb) {
+uint64_t tail = cb->seq_end;
+uint64_t base = (cb->seq_end + cb->end - 1) / cb->end * cb->end;
+
+	CIRCBUF_SEQ_STORE(cb->seq_end, base);
+	CIRCBUF_SEQ_STORE(cb->seq_pushed, base);
+	CIRCBUF_SEQ_STORE(cb->seq_start, base);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	return tail;
+}
+
+/*
+ * set sequence counters to match cursors after circstringbuf_seq_invalidate()
+ *
+ * The data kept its distance from the buffer end, so the groups tracked
+ * are moved as the end sequence is.
+ */
+static inline void
+circstringbuf_seq_realign(circstringbuf_t *cb, uint64_t tail) {
+uint64_t base = cb->seq_end + cb->current_start;
+
+	CIRCBUF_SEQ_STORE(cb->seq_end, base + circstringbuf_used(cb));
+	CIRCBUF_SEQ_STORE(cb->seq_pushed, cb->seq_end);
+	CIRCBUF_SEQ_STORE(cb->seq_start, base);
+
+	for (size_t i = 0; i < cb->groups; i++) {
+
+		cb->group[i][0] += cb->seq_end - tail;
+		cb->group[i][1] += cb->seq_end - tail;
+	}
+}
+
+/*
+ * forget the groups ending at or before the sequence given
+ */
+static void
+circstringbuf_group_trim(circstringbuf_t *cb, uint64_t seq) {
+size_t n = 0;
+
+	while (n < cb->groups && cb->group[n][1] <= seq)
+		n++;
+	if (n) {
+
+		memmove(cb->group, cb->group + n, (cb->groups - n) * sizeof(cb->group[0]));
+		cb->groups -= n;
+	}
+}
+
+/*
+ * find the length of the string starting at the given buffer position
+ */
+static size_t
+circstringbuf_reclen(const circstringbuf_t *cb, size_t position) {
+const char *terminator = memchr(cb->start + position, cb->delim,
+	cb->end - position);
+
+	if (terminator)
+		return terminator - (cb->start + position);
+
+	terminator = memchr(cb->start, cb->delim, position);
+
+	return cb->end - position + (terminator - cb->start);
+}
+
+/*
+ * position of the oldest string in the buffer, past its tag if any
+ */
+static inline size_t
+circstringbuf_head(const circstringbuf_t *cb) {
+
+	return (cb->policy == CIRCBUF_PRIORITY) ?
+		(cb->current_start + 1) % cb->end : cb->current_start;
+}
+
+/*
+ * take the oldest string from the overflow tier, see circstringbuf_tier_t
+ */
+static inline int
+circstringbuf_tier_get(const circstringbuf_t *cb, char *string,
+	size_t *pSize) {
+
+	return cb->tier ?
+		cb->tier->get(cb->tier->ctx, cb->delim, string, pSize) :
+		CIRCBUF_EMPTY;
+}
+
+/*
+ * count the strings terminated in the part of the buffer
+ */
+static size_t
+circstringbuf_count(const circstringbuf_t *cb, size_t position, size_t size) {
+size_t count = 0;
+
+	while (size) {
+
+size_t part = (size < cb->end - position) ? size : cb->end - position;
+const char *from = cb->start + position;
+const char *terminator;
+
+		while ((terminator = memchr(from, cb->delim, cb->start + position + part - from))) {
+
+			count++;
+			from = terminator + 1;
+		}
+		size -= part;
+		position = 0;
+	}
+
+	return count;
+}
+
+/*
+ * advance buffer start past the string the position falls into
+ *
+ * AI: FUNCTION IS NOT THREAD SAFE -- caller holds the lock
+ * AI: SEQUENCE COUNTERS ARE NOT UPDATED -- caller publishes new start
+ * AI: RETURNS false IF NOTHING WAS LOST -- the strings evicted were taken
+ *     by the overflow tier
+ * AI: GROUPS ARE NEVER SPLIT -- if the position falls into the group
+ *     committed, the whole group is evicted
+ */
+static bool
+circstringbuf_evict(circstringbuf_t *cb, size_t position) {
+size_t currentStart = cb->current_start;
+
+	cb->current_start = position % cb->end;
+	while (*(cb->start + cb->current_start) != cb->delim) {
+
+		cb->current_start = (cb->current_start + 1) % cb->end;
+	}
+	cb->current_start = (cb->current_start + 1) % cb->end;
+
+size_t size = (cb->end + cb->current_start - currentStart - 1) % cb->end + 1;
+uint64_t seq = cb->seq_start + size;
+
+	circstringbuf_group_trim(cb, seq);
+	if (cb->groups && cb->group[0][0] < seq) {
+
+		size += cb->group[0][1] - seq;
+		cb->current_start = cb->group[0][1] % cb->end;
+		circstringbuf_group_trim(cb, cb->group[0][1]);
+	}
+
+	if (cb->tier) {
+
+size_t part = (size < cb->end - currentStart) ? size : cb->end - currentStart;
+
+		if (cb->tier->put(cb->tier->ctx, cb->start + currentStart, part,
+			cb->start, size - part) == CIRCBUF_OK)
+			return false;
+	}
+
+	cb->dropped += circstringbuf_count(cb, currentStart, size);
+
+	return true;
+}
+
+/*
+ * check if the size requested fits once the strings of priority up to
+ * the one given are evicted
+ *
+ * AI: DRY RUN OF circstringbuf_evict_priority() -- the window of the oldest
+ *     strings left is slid over the buffer as eviction would, nothing is
+ *     changed
+ */
+static bool
+circstringbuf_evict_priority_fits(const circstringbuf_t *cb, size_t size,
+	int prio) {
+size_t used = circstringbuf_used(cb);
+size_t freed = cb->end - used;
+size_t offset = 0, window = 0;
+size_t lens[CIRCBUF_PRIORITY_WINDOW];
+int prios[CIRCBUF_PRIORITY_WINDOW];
+
+	while (size > freed) {
+
+		for (; window < CIRCBUF_PRIORITY_WINDOW && offset < used; window++) {
+
+size_t position = (cb->current_start + offset) % cb->end;
+
+			prios[window] = *(cb->start + position) & CIRCBUF_PRIO_MAX;
+			lens[window] = circstringbuf_reclen(cb,
+				(position + 1) % cb->end) + 2;
+			offset += lens[window];
+		}
+
+size_t victim = 0;
+
+		for (size_t i = 1; i < window; i++) {
+
+			if (prios[i] < prios[victim])
+				victim = i;
+		}
+		if (!window || prios[victim] > prio)
+			return false;
+
+		freed += lens[victim];
+		window--;
+		memmove(lens + victim, lens + victim + 1,
+			(window - victim) * sizeof(lens[0]));
+		memmove(prios + victim, prios + victim + 1,
+			(window - victim) * sizeof(prios[0]));
+	}
+
+	return true;
+}
+
+/*
+ * evict strings by priority until the size requested fits
+ *
+ * AI: FUNCTION IS NOT THREAD SAFE -- caller holds the lock
+ * AI: BOUNDED TIME PER STRING EVICTED -- only the oldest
+ *     CIRCBUF_PRIORITY_WINDOW strings are considered, the oldest one of
+ *     the lowest priority is dropped and the strings preceding it are
+ *     shifted over it
+ * AI: RETURNS CIRCBUF_FULL WITH NOTHING EVICTED if a string of higher
+ *     priority than the one given would have to be evicted
+ */
+static int
+circstringbuf_evict_priority(circstringbuf_t *cb, size_t size, int prio) {
+
+	if (!circstringbuf_evict_priority_fits(cb, size, prio))
+		return CIRCBUF_FULL;
+
+	while (size > (CIRCBUF_SPACE_LEFT(cb->empty, cb->current_end,
+		cb->current_start, cb->end))) {
+
+size_t used = circstringbuf_used(cb);
+size_t offset = 0, victim = 0, victim_len = 0;
+int lowest = CIRCBUF_PRIO_MAX + 1;
+
+		for (int n = 0; n < CIRCBUF_PRIORITY_WINDOW && offset < used; n++) {
+
+size_t position = (cb->current_start + offset) % cb->end;
+int prio = *(cb->start + position) & CIRCBUF_PRIO_MAX;
+size_t len = circstringbuf_reclen(cb, (position + 1) % cb->end) + 2;
+
+			if (prio < lowest) {
+
+				lowest = prio;
+				victim = offset;
+				victim_len = len;
+			}
+			offset += len;
+		}
+
+		if (victim) {
+
+			/*
+			 * Strings are moved under lock-free readers: rebase
+			 * the counters, so they retry.
+			 */
+uint64_t tail = circstringbuf_seq_invalidate(cb);
+
+			for (size_t i = victim; i > 0; i--) {
+
+				*(cb->start + (cb->current_start + i - 1 + victim_len) % cb->end) =
+					*(cb->start + (cb->current_start + i - 1) % cb->end);
+			}
+			cb->current_start = (cb->current_start + victim_len) % cb->end;
+			if (cb->current_start == cb->current_end)
+				cb->empty = true;
+			circstringbuf_seq_realign(cb, tail);
+		} else {
+
+			cb->current_start = (cb->current_start + victim_len) % cb->end;
+			if (cb->current_start == cb->current_end)
+				cb->empty = true;
+			circstringbuf_seq_start(cb, circstringbuf_used(cb));
+		}
+		cb->dropped++;
+	}
+
+	return CIRCBUF_DATALOSS;
+}
+
+/*
+ * copy the memory bypassing the cache where possible
+ */
+static void
+circstringbuf_stream_copy(char *dst, const char *src, size_t size) {
+
+#if defined(__SSE2__)
+size_t head = (16 - (uintptr_t)dst % 16) % 16;
+
+	if (head > size)
+		head = size;
+	memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	size -= head;
+
+	for (; size >= 16; size -= 16, dst += 16, src += 16)
+		_mm_stream_si128((__m128i *)dst,
+			_mm_loadu_si128((const __m128i *)src));
+#endif /* defined(__SSE2__) */
+
+	memcpy(dst, src, size);
+}
+
+/*
+ * copy the string to the buffer position given and terminate it
+ *
+ * AI: FUNCTION IS NOT THREAD SAFE -- caller holds the lock
+ * AI: CURSORS ARE NOT UPDATED -- caller advances the buffer end
+ * AI: LENGTH INCLUDES THE DELIMITER -- the string itself need not be
+ *     terminated
+ * AI: STREAMING STORES ARE WEAKLY ORDERED -- they are fenced here, before
+ *     the caller publishes the string
+ */
+static void
+circstringbuf_write(circstringbuf_t *cb, size_t position, const char *string,
+	size_t len) {
+bool stream = cb->stream && len >= cb->stream;
+size_t size = len - 1;
+size_t part = (size < cb->end - position) ? size : cb->end - position;
+
+	if (stream) {
+
+		circstringbuf_stream_copy(cb->start + position, string, part);
+		circstringbuf_stream_copy(cb->start, string + part, size - part);
+	} else {
+
+		memcpy(cb->start + position, string, part);
+		memcpy(cb->start, string + part, size - part);
+	}
+	*(cb->start + (position + size) % cb->end) = cb->delim;
+
+#if defined(__SSE2__)
+	if (stream)
+		_mm_sfence();
+#endif /* defined(__SSE2__) */
+}
+
+/*
+ * move the strings stored to the beginning of the buffer
+ *
+ * AI: FUNCTION IS NOT THREAD SAFE -- caller holds the lock
+ * AI: FUNCTION USES NON-TIME-DETERMINISTIC TECHNIQUES (O(buffer size))
+ */
+static void
+circstringbuf_rotate(circstringbuf_t *cb) {
+size_t used = circstringbuf_used(cb);
+
+	if (cb->current_start == 0)
+		return;
+
+uint64_t tail = circstringbuf_seq_invalidate(cb);
+
+	if (cb->current_start + used <= cb->end) {
+
+		memmove(cb->start, cb->start + cb->current_start, used);
+	} else {
+
+		/*
+		 * Rotate the entire buffer left by current_start in place:
+		 * reverse both parts, then reverse the whole.
+		 */
+size_t parts[3][2] = {
+	{ 0, cb->current_start }, { cb->current_start, cb->end }, { 0, cb->end }
+};
+
+		for (int part = 0; part < 3; part++) {
+
+char *left = cb->start + parts[part][0];
+char *right = cb->start + parts[part][1] - 1;
+
+			while (left < right) {
+
+char c = *left;
+
+				*left++ = *right;
+				*right-- = c;
+			}
+		}
+	}
+
+	cb->current_start = 0;
+	cb->current_end = used % cb->end;
+	circstringbuf_seq_realign(cb, tail);
+}
+
 /*
  * initialize string buffer
  */
@@ -38,6 +469,16 @@ circstringbuf_init(circstringbuf_t *cb, char *buffer,
 
 	cb->start = buffer;
 	cb->end = buffer_size;
+	cb->seq_start = cb->seq_end = cb->seq_pushed = 0;
+	cb->policy = CIRCBUF_DROP_OLDEST;
+	cb->dropped = 0;
+	cb->tier = NULL;
+	cb->map_size = 0;
+	cb->stream = 0;
+	cb->delim = '\0';
+#if defined(CIRCBUF_LOCK) && CIRCBUF_LOCK != CIRCBUF_LOCK_NONE
+	circstringbuf_lock_init(&cb->lock);
+#endif
 
 	if (circstringbuf_reset(cb) != CIRCBUF_OK)
 		return CIRCBUF_ERROR;
@@ -59,9 +500,11 @@ circstringbuf_reset(circstringbuf_t *cb) {
 	CIRCBUF_ACQUIRE;
 #endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
 
+	circstringbuf_seq_invalidate(cb);
 	cb->current_start = 0;
 	cb->current_end = 0;
 	cb->empty = true;
+	cb->groups = 0;
 
 #if !defined(CIRCBUF_ACQUIRE_CONTEXT)
 	CIRCBUF_RELEASE;
@@ -74,14 +517,24 @@ circstringbuf_reset(circstringbuf_t *cb) {
  */
 int
 circstringbuf_filllevel(circstringbuf_t *cb) {
+int flevel = 0;
 
-	if (cb->empty) return 0;
+#if defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_ACQUIRE_CONTEXT;
+#else /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+	CIRCBUF_ACQUIRE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
 
-int flevel = (cb->end + cb->current_end - cb->current_start) % cb->end;
+	if (!cb->empty) {
 
-	if (flevel == 0) return 100;
+		flevel = (cb->end + cb->current_end - cb->current_start) % cb->end;
+		flevel = flevel ? flevel * 100 / cb->end : 100;
+	}
 
-	return flevel * 100 / cb->end;
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_RELEASE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+	return flevel;
 }
 
 /*
@@ -98,6 +551,12 @@ circstringbufstatus_t status = CIRCBUF_OK;
 	if (!cb || !pSize || *pSize > cb->end)
 		return CIRCBUF_ERROR;
 
+#if defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_ACQUIRE_CONTEXT;
+#else /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+	CIRCBUF_ACQUIRE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
 size_t space_left = CIRCBUF_SPACE_LEFT(cb->empty, cb->current_end,
 	cb->current_start, cb->end);
 
@@ -110,6 +569,9 @@ size_t space_left = CIRCBUF_SPACE_LEFT(cb->empty, cb->current_end,
 		status |= CIRCBUF_WRAP;
 	}
 
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_RELEASE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
 	return status;
 }
 
@@ -138,6 +600,10 @@ circstringbuf_malloc(circstringbuf_t *cb, char **pStr1,
 	 */
 	if (!cb || !pStr1 || !size || ((flags & CIRCBUF_WRAP) && !pStr2))
 		return CIRCBUF_ERROR;
+	if (cb->policy == CIRCBUF_PRIORITY)
+		return CIRCBUF_ERROR;
+	if (cb->policy != CIRCBUF_DROP_OLDEST)
+		flags &= ~CIRCBUF_DATALOSS;
 	if (*size > cb->end) {
 
 		*pStr1 = NULL;
@@ -160,7 +626,22 @@ size_t space_left = CIRCBUF_SPACE_LEFT(cb->empty, cb->current_end,
 		return CIRCBUF_ERROR;
 	}
 
-size_t currentStart = cb->current_start;
+	/*
+	 * Neither is it acceptable to split the space if the caller has not
+	 * asked for it. The split depends on the buffer end only, so check
+	 * it before anything is evicted.
+	 */
+	if ((cb->current_end + *size > cb->end) && !(flags & CIRCBUF_WRAP)) {
+
+		*pStr1 = NULL;
+		if (pStr2)
+			*pStr2 = NULL;
+
+		return CIRCBUF_ERROR;
+	}
+
+size_t currentEnd = cb->current_end;
+size_t allocated = *size;
 int result = CIRCBUF_OK;
 
 	/*
@@ -176,22 +657,12 @@ int result = CIRCBUF_OK;
 		/*
 		 * New proposed circular buffer start will be the current
 		 * buffer end plus requested allocation size wrapped by
-		 * buffer length.
-		 */
-		cb->current_start = (cb->current_end + *size) % cb->end;
-
-		/*
-		 * If it falls into the middle of some string in the buffer,
-		 * let's advance it till '\0' will be found...
+		 * buffer length. If it falls into the middle of some string
+		 * in the buffer, let's advance it till '\0' will be found
+		 * and skip that '\0'.
 		 */
-		while (*(cb->start + cb->current_start) != '\0') {
-
-			cb->current_start = (cb->current_start + 1) % cb->end;
-		}
-		/* ... and skip that '\0'. */
-		cb->current_start = (cb->current_start + 1) % cb->end;
-
-		result |= CIRCBUF_DATALOSS;
+		if (circstringbuf_evict(cb, cb->current_end + *size))
+			result |= CIRCBUF_DATALOSS;
 	}
 
 	/*
@@ -200,34 +671,31 @@ int result = CIRCBUF_OK;
     if (cb->current_end + *size <= cb->end) {
 
 		*pStr1 = cb->start + cb->current_end;
-		*pStr2 = NULL;
+		if (pStr2)
+			*pStr2 = NULL;
 		cb->current_end = (cb->current_end + *size) % cb->end;
 	} else {
 
 		/*
-		 * Buffer space will be split, and if this is acceptable...
+		 * Buffer space is split, which was checked to be acceptable.
 		 */
-		if (flags & CIRCBUF_WRAP) {
-
-			*pStr1 = cb->start + cb->current_end;
-			*size = cb->end - cb->current_end;
-			*pStr2 = cb->start;
-			cb->current_end = *size - cb->end + cb->current_end;
-
-			result |= CIRCBUF_WRAP;
-		} else {
-
-			/*
-			 * Rolling back effects of the first part of allocation
-			 * algorithm.
-			 */
-			cb->current_start = currentStart;
-			*pStr1 = *pStr2 = NULL;
+		*pStr1 = cb->start + cb->current_end;
+		*size = cb->end - cb->current_end;
+		*pStr2 = cb->start;
+		cb->current_end = allocated - *size;
 
-			return CIRCBUF_ERROR;
-		}
+		result |= CIRCBUF_WRAP;
     }
 
+	/*
+	 * The caller fills the space allocated after we return, so the end
+	 * sequence is advanced alone: lock-free readers stop at seq_pushed,
+	 * which the next string pushed moves past this space.
+	 */
+	if (allocated > space_left)
+		circstringbuf_seq_start(cb,
+			(cb->end + currentEnd - cb->current_start) % cb->end);
+	CIRCBUF_SEQ_STORE(cb->seq_end, cb->seq_end + allocated);
 	cb->empty = false;
 
 	return result;
@@ -252,8 +720,10 @@ circstringbuf_malloc_contiguous(circstringbuf_t *cb,
 	 * Check arguments validity: cb and pStr1 should point to a valid
 	 * address space.
 	 */
-	if (!cb || !pStr)
+	if (!cb || !pStr || cb->policy == CIRCBUF_PRIORITY)
 		return CIRCBUF_ERROR;
+	if (cb->policy != CIRCBUF_DROP_OLDEST)
+		flags &= ~CIRCBUF_DATALOSS;
 	if (size > cb->end) {
 
 		*pStr = NULL;
@@ -276,6 +746,8 @@ size_t space_left = CIRCBUF_SPACE_LEFT(cb->empty, cb->current_end,
 		return CIRCBUF_ERROR;
 	}
 
+size_t currentEnd = cb->current_end;
+
 	/*
 	 * Contiguous allocation is a bit complicated algorithmically.
 	 */
@@ -286,12 +758,7 @@ size_t space_left = CIRCBUF_SPACE_LEFT(cb->empty, cb->current_end,
 		 * by the allocation -- see circstringbuf_malloc() code why
 		 * and how it works.
 		 */
-		cb->current_start = (cb->current_end + size) % cb->end;
-		while (*(cb->start + cb->current_start) != '\0') {
-
-			cb->current_start = (cb->current_start + 1) % cb->end;
-		}
-		cb->current_start = (cb->current_start + 1) % cb->end;
+		circstringbuf_evict(cb, cb->current_end + size);
 	}
 
 	if (cb->current_end + size <= cb->end) {
@@ -303,6 +770,10 @@ size_t space_left = CIRCBUF_SPACE_LEFT(cb->empty, cb->current_end,
 		*pStr = cb->start + cb->current_end;
 		cb->current_end = (cb->current_end + size) % cb->end;
 
+		if (size > space_left)
+			circstringbuf_seq_start(cb,
+				(cb->end + currentEnd - cb->current_start) % cb->end);
+		CIRCBUF_SEQ_STORE(cb->seq_end, cb->seq_end + size);
 	} else {
 
 		/*
@@ -313,12 +784,16 @@ size_t space_left = CIRCBUF_SPACE_LEFT(cb->empty, cb->current_end,
 		 * NB: memmove() time is unpredictable outside the function
 		 * in this case, this code is not a realtime-friendly!
 		 */
-		memmove(cb->start + cb->current_start, cb->start, cb->current_start);
-		cb->current_end -= cb->current_start;
-		cb->current_start = 0;
+		if (size > space_left)
+			circstringbuf_seq_start(cb,
+				(cb->end + currentEnd - cb->current_start) % cb->end);
+		if (size > space_left && cb->current_start == currentEnd)
+			cb->empty = true;
+		circstringbuf_rotate(cb);
 
 		*pStr = cb->start + cb->current_end;
 		cb->current_end = (cb->current_end + size) % cb->end;
+		CIRCBUF_SEQ_STORE(cb->seq_end, cb->seq_end + size);
 	}
 
 	cb->empty = false;
@@ -328,13 +803,17 @@ size_t space_left = CIRCBUF_SPACE_LEFT(cb->empty, cb->current_end,
 
 
 /*
- * push string to buffer
+ * set the overflow policy of the buffer
+ *
+ * AI: CIRCBUF_PRIORITY CHANGES STRING FORMAT -- each string is preceded
+ *     by its tag, so switching to or from it is only possible while the
+ *     buffer is empty
  */
 int
-circstringbuf_push(circstringbuf_t *cb, const char *string) {
-size_t len = strlen(string) + 1;
+circstringbuf_set_policy(circstringbuf_t *cb, circstringbufpolicy_t policy) {
+int result = CIRCBUF_OK;
 
-	if (!cb || len > cb->end)
+	if (!cb || policy < CIRCBUF_DROP_OLDEST || policy > CIRCBUF_PRIORITY)
 		return CIRCBUF_ERROR;
 
 #if defined(CIRCBUF_ACQUIRE_CONTEXT)
@@ -343,57 +822,27 @@ size_t len = strlen(string) + 1;
 	CIRCBUF_ACQUIRE;
 #endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
 
-size_t space_left = CIRCBUF_SPACE_LEFT(cb->empty, cb->current_end,
-	cb->current_start, cb->end);
-
-	if (len > space_left) {
-
-		cb->current_start = (cb->current_end + len - 1) % cb->end;
-		while (*(cb->start + cb->current_start) != '\0') {
-
-			cb->current_start = (cb->current_start + 1) % cb->end;
-		}
-		cb->current_start = (cb->current_start + 1) % cb->end;
-	}
-
-	if (cb->current_end + len <= cb->end) {
-
-		strncpy(cb->start + cb->current_end, string, len - 1);
-		*(cb->start + cb->current_end + len - 1) = '\0';
-		cb->current_end = (cb->current_end + len) % cb->end;
-	} else {
-
-		strncpy(cb->start + cb->current_end, string,
-			cb->end - cb->current_end);
-		strncpy(cb->start, string + (cb->end - cb->current_end),
-			len - cb->end + cb->current_end);
-		*(cb->start + len - cb->end + cb->current_end - 1) = '\0';
-		cb->current_end = len - cb->end + cb->current_end;
-	}
-
-	cb->empty = false;
+	if (!cb->empty && (cb->policy == CIRCBUF_PRIORITY) !=
+		(policy == CIRCBUF_PRIORITY))
+		result = CIRCBUF_ERROR;
+	else
+		cb->policy = policy;
 
 #if !defined(CIRCBUF_ACQUIRE_CONTEXT)
 	CIRCBUF_RELEASE;
 #endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
 
-	if (len > space_left) return CIRCBUF_DATALOSS;
-	return CIRCBUF_OK;
+	return result;
 }
 
 /*
- * return the length of string to be popped by the next circstringbuf_pop()
- *
- * AI: USES strlen() SEMANTICS - terminating '\0' is not included
- *     in length, malloc() in calling code should increment value returned
+ * attach the overflow tier to the buffer
  */
 int
-circstringbuf_strlen(circstringbuf_t *cb, size_t *size) {
+circstringbuf_set_tier(circstringbuf_t *cb, const circstringbuf_tier_t *tier) {
 
-	if (!cb || !size)
+	if (!cb || (tier && (!tier->put || !tier->get)))
 		return CIRCBUF_ERROR;
-	if (cb->empty)
-		return CIRCBUF_EMPTY;
 
 #if defined(CIRCBUF_ACQUIRE_CONTEXT)
 	CIRCBUF_ACQUIRE_CONTEXT;
@@ -401,12 +850,7 @@ circstringbuf_strlen(circstringbuf_t *cb, size_t *size) {
 	CIRCBUF_ACQUIRE;
 #endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
 
-	*size = strlen(cb->start + cb->current_start);
-
-	if (cb->current_start + *size >= cb->end) {
-
-		*size = cb->end - cb->current_start + strlen(cb->start);
-	}
+	cb->tier = tier;
 
 #if !defined(CIRCBUF_ACQUIRE_CONTEXT)
 	CIRCBUF_RELEASE;
@@ -416,18 +860,28 @@ circstringbuf_strlen(circstringbuf_t *cb, size_t *size) {
 }
 
 /*
- * pop string from circular buffer
- *
- * AI: USES PREALLOCATED BUFFER - "string" should have sufficient
- *     space to hold value copied to it by the function
+ * copy long strings pushed bypassing the cache
  */
 int
-circstringbuf_pop(circstringbuf_t *cb, char *string) {
+circstringbuf_set_streaming(circstringbuf_t *cb, size_t threshold) {
 
-	if (!cb || !string)
+	if (!cb)
+		return CIRCBUF_ERROR;
+
+	cb->stream = threshold;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * set the delimiter the strings are terminated with in the buffer
+ */
+int
+circstringbuf_set_delimiter(circstringbuf_t *cb, char delim) {
+int result = CIRCBUF_OK;
+
+	if (!cb)
 		return CIRCBUF_ERROR;
-	if (cb->empty)
-		return CIRCBUF_EMPTY;
 
 #if defined(CIRCBUF_ACQUIRE_CONTEXT)
 	CIRCBUF_ACQUIRE_CONTEXT;
@@ -435,92 +889,352 @@ circstringbuf_pop(circstringbuf_t *cb, char *string) {
 	CIRCBUF_ACQUIRE;
 #endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
 
-	size_t len = strlen(cb->start + cb->current_start);
+	if (!cb->empty && cb->delim != delim)
+		result = CIRCBUF_ERROR;
+	else
+		cb->delim = delim;
 
-	if (cb->current_start + len >= cb->end) {
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_RELEASE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
 
-		len = cb->end - cb->current_start + strlen(cb->start);
-	}
+	return result;
+}
 
-	if (cb->current_start + len < cb->end) {
+/*
+ * push string to buffer, one attempt
+ *
+ * AI: RETURNS CIRCBUF_FULL WITH NOTHING DONE if the string does not fit
+ *     and the policy forbids eviction
+ * AI: STRING MAY BE THE BLOCK OF count STRINGS -- they are copied and
+ *     published at once
+ * AI: STRING IS WRITTEN BY fill IF GIVEN -- under the lock, the delimiter
+ *     is stored here
+ */
+static int
+circstringbuf_put(circstringbuf_t *cb, const char *string, size_t len,
+	int prio, size_t count, circstringbuf_fill_t fill, void *ctx) {
+int result = CIRCBUF_OK;
 
-		strncpy(string, cb->start + cb->current_start, len + 1);
-		cb->current_start = (cb->current_start + len + 1) % cb->end;
-	} else {
+#if defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_ACQUIRE_CONTEXT;
+#else /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+	CIRCBUF_ACQUIRE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+size_t space_left = CIRCBUF_SPACE_LEFT(cb->empty, cb->current_end,
+	cb->current_start, cb->end);
+size_t size = (cb->policy == CIRCBUF_PRIORITY) ? len + 1 : len;
 
-		strncpy(string, cb->start + cb->current_start,
-			cb->end - cb->current_start);
-		strncpy(string + (cb->end - cb->current_start), cb->start,
-			(len - cb->end + cb->current_start + 1) % cb->end);
-		cb->current_start = (len - cb->end + cb->current_start + 1) % cb->end;
+	if (size > space_left) {
+
+		switch (cb->policy) {
+		case CIRCBUF_DROP_NEWEST:
+			cb->dropped += count;
+			/* fall through */
+		case CIRCBUF_BLOCK:
+			result = CIRCBUF_FULL;
+			break;
+		case CIRCBUF_PRIORITY:
+			result = circstringbuf_evict_priority(cb, size, prio);
+			if (result == CIRCBUF_FULL)
+				cb->dropped += count;
+			break;
+		default:
+			if (circstringbuf_evict(cb, cb->current_end + len - 1))
+				result = CIRCBUF_DATALOSS;
+			circstringbuf_seq_start(cb,
+				(cb->end + cb->current_end - cb->current_start) % cb->end);
+			break;
+		}
 	}
 
-	if (cb->current_start == cb->current_end)
-		cb->empty = true;
+	if (result != CIRCBUF_FULL) {
+
+		if (cb->policy == CIRCBUF_PRIORITY) {
+
+			*(cb->start + cb->current_end) = CIRCBUF_PRIO_TAG | prio;
+			cb->current_end = (cb->current_end + 1) % cb->end;
+		}
+
+		if (fill) {
+
+size_t part = (len - 1 < cb->end - cb->current_end) ?
+	len - 1 : cb->end - cb->current_end;
+
+			fill(ctx, cb->start + cb->current_end, part, cb->start);
+			*(cb->start + (cb->current_end + len - 1) % cb->end) = cb->delim;
+		} else
+			circstringbuf_write(cb, cb->current_end, string, len);
+		cb->current_end = (cb->current_end + len) % cb->end;
+
+		CIRCBUF_SEQ_STORE(cb->seq_end, cb->seq_end + size);
+		CIRCBUF_SEQ_STORE(cb->seq_pushed, cb->seq_end);
+		cb->empty = false;
+	}
 
 #if !defined(CIRCBUF_ACQUIRE_CONTEXT)
 	CIRCBUF_RELEASE;
 #endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
 
+	return result;
+}
+
+/*
+ * push string to buffer
+ */
+int
+circstringbuf_push(circstringbuf_t *cb, const char *string) {
+
+	return circstringbuf_push_prio(cb, string, 0);
+}
+
+/*
+ * push string of the known size to buffer
+ *
+ * AI: CIRCBUF_BLOCK POLICY WAITS with CIRCBUF_WAIT outside of the lock
+ *     until the consumer frees up enough space
+ */
+static int
+circstringbuf_push_len(circstringbuf_t *cb, const char *string, size_t len,
+	int prio, size_t count, circstringbuf_fill_t fill, void *ctx) {
+
+	if (len > cb->end || prio < 0 || prio > CIRCBUF_PRIO_MAX)
+		return CIRCBUF_ERROR;
+	if (cb->policy == CIRCBUF_PRIORITY && len + 1 > cb->end)
+		return CIRCBUF_ERROR;
+
+	for (;;) {
+
+int result = circstringbuf_put(cb, string, len, prio, count, fill, ctx);
+
+		if (result != CIRCBUF_FULL || cb->policy != CIRCBUF_BLOCK)
+			return result;
+
+		CIRCBUF_WAIT;
+	}
+}
+
+/*
+ * push string of the given priority to buffer
+ */
+int
+circstringbuf_push_prio(circstringbuf_t *cb, const char *string, int prio) {
+
+	if (!cb || !string)
+		return CIRCBUF_ERROR;
+
+	return circstringbuf_push_len(cb, string, strlen(string) + 1, prio, 1,
+		NULL, NULL);
+}
+
+/*
+ * push string of the given length to buffer
+ *
+ * AI: NO SCAN FOR '\0' -- len bytes are copied as they are and terminated
+ */
+int
+circstringbuf_push_n(circstringbuf_t *cb, const char *string, size_t len) {
+
+	if (!cb || (!string && len) || len >= cb->end)
+		return CIRCBUF_ERROR;
+
+	return circstringbuf_push_len(cb, string, len + 1, 0, 1, NULL, NULL);
+}
+
+/*
+ * push the string of the given length written by the callback to buffer
+ */
+int
+circstringbuf_push_fill(circstringbuf_t *cb, size_t len,
+	circstringbuf_fill_t fill, void *ctx) {
+
+	if (!cb || !fill || len >= cb->end)
+		return CIRCBUF_ERROR;
+
+	return circstringbuf_push_len(cb, NULL, len + 1, 0, 1, fill, ctx);
+}
+
+/*
+ * format the value as the given number of lowercase hex digits
+ */
+void
+circstringbuf_hex(char *digits, size_t count, uint64_t value) {
+
+	while (count--) {
+
+		digits[count] = "0123456789abcdef"[value & 0xF];
+		value >>= 4;
+	}
+}
+
+/*
+ * nanoseconds of monotonic clock, of the wall one if there is no
+ * monotonic clock
+ */
+uint64_t
+circstringbuf_now(void) {
+struct timespec ts;
+
+#if defined(CIRCBUF_POSIX)
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#else /* defined(CIRCBUF_POSIX) */
+	timespec_get(&ts, TIME_UTC);
+#endif /* defined(CIRCBUF_POSIX) */
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * push the block of strings to buffer at once
+ *
+ * AI: ONE LOCK, ONE COPY AND ONE PUBLISH for all the strings of the block
+ */
+int
+circstringbuf_push_bulk(circstringbuf_t *cb, const char *strings, size_t size,
+	size_t count) {
+
+	if (!cb || !strings || !size || !count || strings[size - 1] != cb->delim)
+		return CIRCBUF_ERROR;
+	if (cb->policy == CIRCBUF_PRIORITY)
+		return CIRCBUF_ERROR;
+
+	return circstringbuf_push_len(cb, strings, size, 0, count, NULL, NULL);
+}
+
+/*
+ * begin the group of strings pushed to buffer at once
+ */
+int
+circstringbuf_begin(circstringbuf_t *cb, circstringbuf_txn_t *txn) {
+
+	if (!cb || !txn || cb->policy == CIRCBUF_PRIORITY)
+		return CIRCBUF_ERROR;
+
+	txn->cb = cb;
+	txn->size = 0;
+	txn->count = 0;
+
 	return CIRCBUF_OK;
 }
 
 /*
- * build a span from the string from circular buffer
+ * append string to the group
  *
  * AI: FUNCTION IS NOT THREAD SAFE
- * AI: DO NOT WRAP WITH LOCKING — caller should use serialize macros
- * AI: RETURNS POINTERS INTO INTERNAL STATE — span must be consumed immediately
- * AI: RETURNS NULL ON FAILURE — caller must check *pStr1 != NULL
- * AI: HAS DIFFERENT NULL SEMANTICS — caller must check if *pStr2 != NULL
- *     to check if string is two-part one
+ * AI: STRING IS WRITTEN PAST THE BUFFER END -- nothing is published but
+ *     the new buffer start if the oldest strings are evicted
  */
 int
-circstringbuf_span(circstringbuf_t* cb, char **pStr1, size_t *pSize1, char **pStr2) {
+circstringbuf_append(circstringbuf_txn_t *txn, const char *string) {
 
-	if (!cb || !pStr1 || !pSize1 || !pStr2)
+	if (!txn || !txn->cb || !string)
 		return CIRCBUF_ERROR;
-	*pStr1 = *pStr2 = NULL;
-	*pSize1 = 0;
-	if (cb->empty)
-		return CIRCBUF_EMPTY;
 
-	size_t len = strlen(cb->start + cb->current_start);
+circstringbuf_t *cb = txn->cb;
+size_t len = strlen(string) + 1;
+int result = CIRCBUF_OK;
+
+	if (txn->size + len > cb->end)
+		return CIRCBUF_ERROR;
+
+size_t space_left = CIRCBUF_SPACE_LEFT(cb->empty, cb->current_end,
+	cb->current_start, cb->end);
+
+	if (txn->size + len > space_left) {
+
+		if (cb->policy != CIRCBUF_DROP_OLDEST) {
+
+			if (cb->policy == CIRCBUF_DROP_NEWEST)
+				cb->dropped++;
 
-	if (cb->current_start + len >= cb->end) {
+			return CIRCBUF_FULL;
+		}
 
-		len = cb->end - cb->current_start + strlen(cb->start);
+		if (circstringbuf_evict(cb, cb->current_end + txn->size + len - 1))
+			result = CIRCBUF_DATALOSS;
+		if (cb->current_start == cb->current_end)
+			cb->empty = true;
+		circstringbuf_seq_start(cb, circstringbuf_used(cb));
 	}
 
-	if (cb->current_start + len < cb->end) {
+	circstringbuf_write(cb, (cb->current_end + txn->size) % cb->end,
+		string, len);
+	txn->size += len;
+	txn->count++;
 
-		*pStr1 = cb->start + cb->current_start;
-		*pSize1 = len + 1;
-		*pStr2 = NULL;
-		cb->current_start = (cb->current_start + len + 1) % cb->end;
-	} else {
+	return result;
+}
 
-		*pStr1 = cb->start + cb->current_start;
-		*pSize1 = cb->end - cb->current_start;
-		*pStr2 = cb->start;
-		cb->current_start = (len - cb->end + cb->current_start + 1) % cb->end;
+/*
+ * make all the strings of the group visible at once
+ *
+ * AI: FUNCTION IS NOT THREAD SAFE
+ * AI: ONE RELEASE STORE PER GROUP -- the buffer end sequence
+ */
+int
+circstringbuf_commit(circstringbuf_txn_t *txn) {
+
+	if (!txn || !txn->cb)
+		return CIRCBUF_ERROR;
+
+circstringbuf_t *cb = txn->cb;
+
+	if (txn->size) {
+
+uint64_t seq = cb->seq_end;
+
+		cb->current_end = (cb->current_end + txn->size) % cb->end;
+		CIRCBUF_SEQ_STORE(cb->seq_end, seq + txn->size);
+		CIRCBUF_SEQ_STORE(cb->seq_pushed, cb->seq_end);
+		cb->empty = false;
+
+		if (txn->count > 1) {
+
+			circstringbuf_group_trim(cb, cb->seq_start);
+			if (cb->groups == CIRCBUF_GROUPS) {
+
+				cb->group[CIRCBUF_GROUPS - 1][1] = cb->seq_end;
+			} else {
+
+				cb->group[cb->groups][0] = seq;
+				cb->group[cb->groups][1] = cb->seq_end;
+				cb->groups++;
+			}
+		}
 	}
 
-	if (cb->current_start == cb->current_end)
-		cb->empty = true;
+	txn->cb = NULL;
 
 	return CIRCBUF_OK;
 }
 
 /*
- * pop string from circular buffer to nowhere (i.e, drop it away)
+ * discard all the strings of the group
  */
 int
-circstringbuf_drop(circstringbuf_t* cb) {
+circstringbuf_abort(circstringbuf_txn_t *txn) {
 
-	if (!cb)
+	if (!txn || !txn->cb)
 		return CIRCBUF_ERROR;
-	if (cb->empty)
+
+	txn->cb = NULL;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * return the length of string to be popped by the next circstringbuf_pop()
+ *
+ * AI: USES strlen() SEMANTICS - terminating '\0' is not included
+ *     in length, malloc() in calling code should increment value returned
+ */
+int
+circstringbuf_strlen(circstringbuf_t *cb, size_t *size) {
+
+	if (!cb || !size)
+		return CIRCBUF_ERROR;
+	if (cb->empty && !cb->tier)
 		return CIRCBUF_EMPTY;
 
 #if defined(CIRCBUF_ACQUIRE_CONTEXT)
@@ -529,28 +1243,909 @@ circstringbuf_drop(circstringbuf_t* cb) {
 	CIRCBUF_ACQUIRE;
 #endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
 
-	size_t len = strlen(cb->start + cb->current_start);
+int result = circstringbuf_tier_get(cb, NULL, size);
 
-	if (cb->current_start + len >= cb->end) {
+	if (result == CIRCBUF_EMPTY && !cb->empty) {
 
-		len = cb->end - cb->current_start + strlen(cb->start);
+		*size = circstringbuf_reclen(cb, circstringbuf_head(cb));
+		result = CIRCBUF_OK;
 	}
 
-	if (cb->current_start + len < cb->end) {
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_RELEASE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
 
-		cb->current_start = (cb->current_start + len + 1) % cb->end;
-	} else {
+	return result;
+}
 
-		cb->current_start = (len - cb->end + cb->current_start + 1) % cb->end;
-	}
+/*
+ * pop string from circular buffer
+ *
+ * AI: USES PREALLOCATED BUFFER - "string" should have sufficient
+ *     space to hold value copied to it by the function
+ */
+int
+circstringbuf_pop(circstringbuf_t *cb, char *string) {
 
-	if (cb->current_start == cb->current_end)
-		cb->empty = true;
+	return circstringbuf_pop_n(cb, string, SIZE_MAX, NULL);
+}
+
+/*
+ * pop string from circular buffer to the buffer of the size given
+ *
+ * AI: ONE PASS -- the length is found by memchr() and the string is
+ *     copied by memcpy(), or left in the buffer if it does not fit
+ */
+int
+circstringbuf_pop_n(circstringbuf_t *cb, char *string, size_t size,
+	size_t *pLen) {
+
+	if (!cb || !string)
+		return CIRCBUF_ERROR;
+	if (cb->empty && !cb->tier)
+		return CIRCBUF_EMPTY;
+
+#if defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_ACQUIRE_CONTEXT;
+#else /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+	CIRCBUF_ACQUIRE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+size_t len = 0;
+int result = circstringbuf_tier_get(cb, NULL, &len);
+
+	if (result == CIRCBUF_OK) {
+
+		if (len >= size)
+			result = CIRCBUF_FULL;
+		else
+			circstringbuf_tier_get(cb, string, NULL);
+	} else if (result == CIRCBUF_EMPTY && !cb->empty) {
+
+		size_t position = circstringbuf_head(cb);
+
+		len = circstringbuf_reclen(cb, position);
+		if (len >= size) {
+
+			result = CIRCBUF_FULL;
+		} else if (position + len < cb->end) {
+
+			memcpy(string, cb->start + position, len);
+			string[len] = '\0';
+		} else {
+
+			memcpy(string, cb->start + position, cb->end - position);
+			memcpy(string + (cb->end - position), cb->start,
+				len - cb->end + position);
+			string[len] = '\0';
+		}
+
+		if (result != CIRCBUF_FULL) {
+
+			cb->current_start = (position + len + 1) % cb->end;
+
+			if (cb->current_start == cb->current_end)
+				cb->empty = true;
+			circstringbuf_seq_start(cb, circstringbuf_used(cb));
+			result = CIRCBUF_OK;
+		}
+	}
 
 #if !defined(CIRCBUF_ACQUIRE_CONTEXT)
 	CIRCBUF_RELEASE;
 #endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
 
-	return CIRCBUF_OK;
+	if (pLen && result != CIRCBUF_EMPTY)
+		*pLen = len;
+
+	return result;
 }
 
+/*
+ * copy the beginning of the oldest string without popping it
+ */
+int
+circstringbuf_peek(circstringbuf_t *cb, char *string, size_t size,
+	size_t *pLen) {
+
+	if (!cb || !string || !size)
+		return CIRCBUF_ERROR;
+	if (cb->empty && !cb->tier)
+		return CIRCBUF_EMPTY;
+
+#if defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_ACQUIRE_CONTEXT;
+#else /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+	CIRCBUF_ACQUIRE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+size_t len = 0;
+int result = circstringbuf_tier_get(cb, NULL, &len);
+
+	if (result == CIRCBUF_OK) {
+
+		result = CIRCBUF_ERROR;
+	} else if (result == CIRCBUF_EMPTY && !cb->empty) {
+
+		size_t position = circstringbuf_head(cb);
+
+		len = circstringbuf_reclen(cb, position);
+
+		size_t copy = (len < size - 1) ? len : size - 1;
+		size_t part = (copy < cb->end - position) ? copy : cb->end - position;
+
+		memcpy(string, cb->start + position, part);
+		memcpy(string + part, cb->start, copy - part);
+		string[copy] = '\0';
+		result = CIRCBUF_OK;
+	}
+
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_RELEASE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+	if (pLen && result == CIRCBUF_OK)
+		*pLen = len;
+
+	return result;
+}
+
+/*
+ * build a span from the string from circular buffer
+ *
+ * AI: FUNCTION IS NOT THREAD SAFE
+ * AI: DO NOT WRAP WITH LOCKING — caller should use serialize macros
+ * AI: RETURNS POINTERS INTO INTERNAL STATE — span must be consumed immediately
+ * AI: RETURNS NULL ON FAILURE — caller must check *pStr1 != NULL
+ * AI: HAS DIFFERENT NULL SEMANTICS — caller must check if *pStr2 != NULL
+ *     to check if string is two-part one
+ */
+int
+circstringbuf_span(circstringbuf_t* cb, char **pStr1, size_t *pSize1, char **pStr2) {
+
+	if (!cb || !pStr1 || !pSize1 || !pStr2)
+		return CIRCBUF_ERROR;
+	*pStr1 = *pStr2 = NULL;
+	*pSize1 = 0;
+	if (circstringbuf_tier_get(cb, NULL, pSize1) != CIRCBUF_EMPTY) {
+
+		*pSize1 = 0;
+
+		return CIRCBUF_ERROR;
+	}
+	if (cb->empty)
+		return CIRCBUF_EMPTY;
+
+	size_t position = circstringbuf_head(cb);
+	size_t len = circstringbuf_reclen(cb, position);
+
+	if (position + len < cb->end) {
+
+		*pStr1 = cb->start + position;
+		*pSize1 = len + 1;
+		*pStr2 = NULL;
+	} else {
+
+		*pStr1 = cb->start + position;
+		*pSize1 = cb->end - position;
+		*pStr2 = cb->start;
+	}
+	cb->current_start = (position + len + 1) % cb->end;
+
+	if (cb->current_start == cb->current_end)
+		cb->empty = true;
+	circstringbuf_seq_start(cb, circstringbuf_used(cb));
+
+	/*
+	 * The string is released, so its delimiter may be turned into '\0'
+	 * for the caller to get the C string.
+	 */
+	*(cb->start + (position + len) % cb->end) = '\0';
+
+	return CIRCBUF_OK;
+}
+
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+/*
+ * take the lock of the buffer
+ */
+void
+circstringbuf_lock(circstringbuf_t *cb) {
+
+	(void)cb;
+	CIRCBUF_ACQUIRE;
+}
+
+/*
+ * release the lock of the buffer
+ */
+void
+circstringbuf_unlock(circstringbuf_t *cb) {
+
+	(void)cb;
+	CIRCBUF_RELEASE;
+}
+
+/*
+ * span the string, keeping the lock held if it is spanned
+ *
+ * AI: LOCK IS HELD ON SUCCESS -- caller releases it by circstringbuf_unlock()
+ */
+int
+circstringbuf_span_guarded(circstringbuf_t *cb, char **pStr1, size_t *pSize1,
+	char **pStr2) {
+
+	if (!cb)
+		return CIRCBUF_ERROR;
+
+	CIRCBUF_ACQUIRE;
+
+int result = circstringbuf_span(cb, pStr1, pSize1, pStr2);
+
+	if (result < 0)
+		CIRCBUF_RELEASE;
+
+	return result;
+}
+
+/*
+ * allocate the space, keeping the lock held if it is allocated
+ *
+ * AI: LOCK IS HELD ON SUCCESS -- caller releases it by circstringbuf_unlock()
+ */
+int
+circstringbuf_malloc_guarded(circstringbuf_t *cb, char **pStr1, size_t *size,
+	char **pStr2, circstringbufstatus_t flags) {
+
+	if (!cb)
+		return CIRCBUF_ERROR;
+
+	CIRCBUF_ACQUIRE;
+
+int result = circstringbuf_malloc(cb, pStr1, size, pStr2, flags);
+
+	if (result < 0)
+		CIRCBUF_RELEASE;
+
+	return result;
+}
+#endif /* !defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+/*
+ * pop string from circular buffer to nowhere (i.e, drop it away)
+ */
+int
+circstringbuf_drop(circstringbuf_t* cb) {
+
+	if (!cb)
+		return CIRCBUF_ERROR;
+	if (cb->empty && !cb->tier)
+		return CIRCBUF_EMPTY;
+
+#if defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_ACQUIRE_CONTEXT;
+#else /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+	CIRCBUF_ACQUIRE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+int result = circstringbuf_tier_get(cb, NULL, NULL);
+
+	if (result == CIRCBUF_EMPTY && !cb->empty) {
+
+		size_t position = circstringbuf_head(cb);
+		size_t len = circstringbuf_reclen(cb, position);
+
+		cb->current_start = (position + len + 1) % cb->end;
+
+		if (cb->current_start == cb->current_end)
+			cb->empty = true;
+		circstringbuf_seq_start(cb, circstringbuf_used(cb));
+		result = CIRCBUF_OK;
+	}
+
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_RELEASE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+	return result;
+}
+
+
+/*
+ * free up the bytes at the buffer start the caller has consumed directly
+ *
+ * AI: SIZE IS NOT CHECKED TO COVER WHOLE STRINGS -- caller consumes data
+ *     in the way it was pushed
+ */
+int
+circstringbuf_advance(circstringbuf_t *cb, size_t size) {
+int result = CIRCBUF_OK;
+
+	if (!cb)
+		return CIRCBUF_ERROR;
+
+#if defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_ACQUIRE_CONTEXT;
+#else /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+	CIRCBUF_ACQUIRE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+	if (size > circstringbuf_used(cb)) {
+
+		result = CIRCBUF_ERROR;
+	} else if (size) {
+
+		cb->current_start = (cb->current_start + size) % cb->end;
+		if (cb->current_start == cb->current_end)
+			cb->empty = true;
+		circstringbuf_seq_start(cb, circstringbuf_used(cb));
+	}
+
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_RELEASE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+	return result;
+}
+
+
+/*
+ * get the oldest strings in place without consuming them
+ *
+ * AI: ONE PASS -- strings are delimited by memchr() until either limit
+ *     is reached, nothing is copied
+ */
+int
+circstringbuf_peek_bulk(circstringbuf_t *cb, size_t max_records,
+	size_t max_bytes, circstringbuf_segment_t *seg1,
+	circstringbuf_segment_t *seg2, size_t *pCount) {
+size_t bytes = 0, count = 0;
+
+	if (!cb || !seg1 || !seg2 || !pCount || cb->policy == CIRCBUF_PRIORITY)
+		return CIRCBUF_ERROR;
+
+	seg1->data = seg2->data = NULL;
+	seg1->size = seg2->size = 0;
+	*pCount = 0;
+
+#if defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_ACQUIRE_CONTEXT;
+#else /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+	CIRCBUF_ACQUIRE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+size_t len = 0;
+int result = circstringbuf_tier_get(cb, NULL, &len);
+
+	if (result == CIRCBUF_OK) {
+
+		result = CIRCBUF_ERROR;
+	} else if (result == CIRCBUF_EMPTY && !cb->empty) {
+
+		size_t used = circstringbuf_used(cb);
+		size_t limit = (max_bytes < used) ? max_bytes : used;
+
+		while (count < max_records && bytes < limit) {
+
+			len = circstringbuf_reclen(cb,
+				(cb->current_start + bytes) % cb->end) + 1;
+			if (bytes + len > limit)
+				break;
+			bytes += len;
+			count++;
+		}
+
+		result = (count || !max_records) ? CIRCBUF_OK : CIRCBUF_FULL;
+	}
+
+	if (bytes) {
+
+		seg1->data = cb->start + cb->current_start;
+		seg1->size = (bytes < cb->end - cb->current_start) ?
+			bytes : cb->end - cb->current_start;
+		if (bytes > seg1->size) {
+
+			seg2->data = cb->start;
+			seg2->size = bytes - seg1->size;
+		}
+	}
+
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_RELEASE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+	*pCount = count;
+
+	return result;
+}
+
+/*
+ * consume the oldest strings
+ */
+int
+circstringbuf_consume(circstringbuf_t *cb, size_t count) {
+int result = CIRCBUF_OK;
+
+	if (!cb)
+		return CIRCBUF_ERROR;
+
+#if defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_ACQUIRE_CONTEXT;
+#else /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+	CIRCBUF_ACQUIRE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+size_t used = circstringbuf_used(cb);
+size_t bytes = 0;
+
+	for (size_t n = 0; n < count; n++) {
+
+		if (bytes >= used) {
+
+			result = CIRCBUF_ERROR;
+			break;
+		}
+		bytes += circstringbuf_reclen(cb,
+			(cb->current_start + bytes) % cb->end) + 1;
+	}
+
+	if (result == CIRCBUF_OK && bytes) {
+
+		cb->current_start = (cb->current_start + bytes) % cb->end;
+		if (cb->current_start == cb->current_end)
+			cb->empty = true;
+		circstringbuf_seq_start(cb, circstringbuf_used(cb));
+	}
+
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_RELEASE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+	return result;
+}
+
+
+/*
+ * copy all the strings stored in the buffer without locking it
+ *
+ * AI: LOCK-FREE READER -- never touches current_start/current_end, only
+ *     sequence counters and the data itself
+ * AI: DATA IS COPIED RACY AND VERIFIED AFTERWARDS -- producers advance
+ *     seq_start before overwriting bytes, so everything in the copy at or
+ *     past seq_start re-read after the copy is intact
+ */
+static int
+circstringbuf_copy_live(circstringbuf_t *cb, char *buffer,
+	size_t buffer_size, size_t *pSize, uint64_t *pTail) {
+
+	*pSize = 0;
+	*pTail = 0;
+
+	for (int attempt = 0; attempt <= CIRCBUF_SNAPSHOT_RETRIES; attempt++) {
+
+uint64_t head = CIRCBUF_SEQ_LOAD(cb->seq_start);
+uint64_t tail = CIRCBUF_SEQ_LOAD(cb->seq_pushed);
+
+		*pTail = tail;
+		/*
+		 * Either nothing is stored, or the space allocated only, which
+		 * could have evicted every string pushed before it.
+		 */
+		if (tail <= head)
+			return CIRCBUF_EMPTY;
+		/* Counters were re-based between the loads, re-read them. */
+		if (tail - head > cb->end)
+			continue;
+
+		/*
+		 * Copy no more than the newest buffer_size bytes: one or two
+		 * memcpy()s depending on wrapping, and the byte preceding
+		 * the copy to check later if it starts on a string boundary.
+		 */
+uint64_t from = head;
+char preceding = cb->delim;
+
+		if (tail - from > buffer_size) {
+
+			from = tail - buffer_size;
+			preceding = *(cb->start + (from - 1) % cb->end);
+		}
+
+size_t size = tail - from;
+size_t offset = from % cb->end;
+size_t part1 = (size < cb->end - offset) ? size : cb->end - offset;
+
+		memcpy(buffer, cb->start + offset, part1);
+		memcpy(buffer + part1, cb->start, size - part1);
+
+		/*
+		 * Everything below the current start could have been
+		 * overwritten while we were copying.
+		 */
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+uint64_t evicted = CIRCBUF_SEQ_LOAD(cb->seq_start);
+
+		if (evicted > from && attempt < CIRCBUF_SNAPSHOT_RETRIES)
+			continue;
+		if (evicted >= tail)
+			continue;
+
+size_t skip = 0;
+
+		if (evicted >= from) {
+
+			/* Current start is always at a string boundary. */
+			skip = evicted - from;
+		} else if (preceding != cb->delim) {
+
+			/* Snapshot starts in the middle of the string. */
+			while (skip < size && buffer[skip] != cb->delim)
+				skip++;
+			skip++;
+		}
+
+		if (skip >= size)
+			continue;
+		if (skip)
+			memmove(buffer, buffer + skip, size - skip);
+		*pSize = size - skip;
+
+		return (from > head) ? CIRCBUF_DATALOSS : CIRCBUF_OK;
+	}
+
+	return CIRCBUF_ERROR;
+}
+
+int
+circstringbuf_snapshot(circstringbuf_t *cb, char *buffer,
+	size_t buffer_size, size_t *pSize) {
+uint64_t tail;
+
+	if (!cb || !buffer || !pSize)
+		return CIRCBUF_ERROR;
+
+	return circstringbuf_copy_live(cb, buffer, buffer_size, pSize, &tail);
+}
+
+/*
+ * move the strings stored to the beginning of the buffer
+ */
+int
+circstringbuf_linearize(circstringbuf_t *cb) {
+
+	if (!cb)
+		return CIRCBUF_ERROR;
+
+#if defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_ACQUIRE_CONTEXT;
+#else /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+	CIRCBUF_ACQUIRE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+	circstringbuf_rotate(cb);
+
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_RELEASE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * move the strings stored to the new buffer of the different size
+ *
+ * AI: TWO PHASES -- the bulk of the data is copied lock-free as the snapshot
+ *     is, only the strings pushed meanwhile are copied under the lock
+ * AI: OLD BUFFER MAY BE FREED ONCE THE FUNCTION RETURNS, but not while any
+ *     lock-free reader (snapshot, dump) may be still reading it
+ */
+int
+circstringbuf_resize(circstringbuf_t *cb, char *buffer, size_t buffer_size) {
+
+	if (!cb || !buffer || buffer_size < 2 || cb->map_size)
+		return CIRCBUF_ERROR;
+
+size_t kept = 0;
+uint64_t copied_end = 0;
+int result = circstringbuf_copy_live(cb, buffer, buffer_size, &kept,
+	&copied_end);
+bool copied = (result != CIRCBUF_ERROR);
+
+	if (!copied)
+		kept = 0;
+	result = (result == CIRCBUF_DATALOSS) ? CIRCBUF_DATALOSS : CIRCBUF_OK;
+
+#if defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_ACQUIRE_CONTEXT;
+#else /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+	CIRCBUF_ACQUIRE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+	/*
+	 * The first phase gave up: everything is copied here, from the head.
+	 */
+	if (!copied)
+		copied_end = cb->seq_start;
+
+	/*
+	 * Strings copied by the first phase could have been popped or evicted
+	 * meanwhile, while the newer ones are still in the old buffer only.
+	 */
+uint64_t head = cb->seq_start;
+uint64_t tail = cb->seq_end;
+uint64_t copied_start = copied_end - kept;
+size_t skip = 0;
+
+	if (head >= copied_end) {
+
+		skip = kept;
+	} else if (head > copied_start) {
+
+		skip = head - copied_start;
+	}
+
+uint64_t delta_start = (head > copied_end) ? head : copied_end;
+size_t delta = tail - delta_start;
+
+	/*
+	 * Drop the oldest whole strings until the rest fits, first among
+	 * the copied ones, then among the new ones.
+	 */
+	while (kept - skip + delta > buffer_size && skip < kept) {
+
+		skip += (char *)memchr(buffer + skip, cb->delim, kept - skip) -
+			(buffer + skip) + 1;
+		result = CIRCBUF_DATALOSS;
+	}
+	while (delta > buffer_size) {
+
+size_t len = circstringbuf_reclen(cb, delta_start % cb->end) + 1;
+
+		delta_start += len;
+		delta -= len;
+		result = CIRCBUF_DATALOSS;
+	}
+
+	kept -= skip;
+	memmove(buffer, buffer + skip, kept);
+
+size_t offset = delta_start % cb->end;
+size_t part1 = (delta < cb->end - offset) ? delta : cb->end - offset;
+
+	memcpy(buffer + kept, cb->start + offset, part1);
+	memcpy(buffer + kept + part1, cb->start, delta - part1);
+
+	cb->start = buffer;
+	cb->end = buffer_size;
+uint64_t seq_tail = circstringbuf_seq_invalidate(cb);
+	cb->current_start = 0;
+	cb->current_end = (kept + delta) % buffer_size;
+	cb->empty = (kept + delta == 0);
+	circstringbuf_seq_realign(cb, seq_tail);
+
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_RELEASE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+	return result;
+}
+
+#if defined(CIRCBUF_POSIX)
+/*
+ * write all the strings stored in the buffer to the file descriptor
+ *
+ * AI: ASYNC-SIGNAL-SAFE -- no locks, no allocation, only atomic loads
+ *     and write()
+ * AI: BEST EFFORT -- if producers are running concurrently some strings
+ *     at the head of the dump may be already overwritten
+ */
+int
+circstringbuf_dump_fd(circstringbuf_t *cb, int fd) {
+
+	if (!cb || fd < 0)
+		return CIRCBUF_ERROR;
+
+uint64_t head = CIRCBUF_SEQ_LOAD(cb->seq_start);
+uint64_t tail = CIRCBUF_SEQ_LOAD(cb->seq_pushed);
+
+	/* Nothing is stored but the space allocated, if anything. */
+	if (tail <= head)
+		return CIRCBUF_EMPTY;
+	if (tail - head > cb->end)
+		head = tail - cb->end;
+
+size_t size = tail - head;
+size_t offset = head % cb->end;
+size_t part1 = (size < cb->end - offset) ? size : cb->end - offset;
+ssize_t written = write(fd, cb->start + offset, part1);
+
+	if (written < 0)
+		return CIRCBUF_ERROR;
+	if ((size_t)written < part1)
+		return CIRCBUF_DATALOSS;
+
+	if (size > part1) {
+
+		written = write(fd, cb->start, size - part1);
+		if (written < 0)
+			return CIRCBUF_ERROR;
+		if ((size_t)written < size - part1)
+			return CIRCBUF_DATALOSS;
+	}
+
+	return CIRCBUF_OK;
+}
+
+static circstringbuf_t *volatile fatal_cb;
+static volatile int fatal_fd = -1;
+
+static void
+circstringbuf_fatal(int signo) {
+
+	circstringbuf_dump_fd(fatal_cb, fatal_fd);
+	raise(signo);
+}
+
+/*
+ * dump the buffer by circstringbuf_dump_fd() on fatal signals
+ *
+ * AI: SA_RESETHAND -- the handler fires once, then the signal is re-raised
+ *     with default disposition, so the process terminates as it would
+ */
+int
+circstringbuf_dump_on_signal(circstringbuf_t *cb, int fd) {
+static const int signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+struct sigaction action;
+
+	if (!cb || fd < 0)
+		return CIRCBUF_ERROR;
+
+	fatal_cb = cb;
+	fatal_fd = fd;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = circstringbuf_fatal;
+	action.sa_flags = SA_RESETHAND | SA_NODEFER;
+	sigemptyset(&action.sa_mask);
+
+	for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++) {
+
+		if (sigaction(signals[i], &action, NULL) != 0)
+			return CIRCBUF_ERROR;
+	}
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * bind the memory to NUMA node
+ *
+ * AI: RAW SYSCALLS -- libnuma is not required, MPOL_BIND is 2 there
+ */
+static int
+circstringbuf_bind(void *memory, size_t size, int node) {
+
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_getcpu)
+unsigned long mask[4] = { 0 };
+unsigned cpu, local;
+
+	if (node == CIRCBUF_NODE_LOCAL) {
+
+		if (syscall(SYS_getcpu, &cpu, &local, NULL) < 0)
+			return CIRCBUF_ERROR;
+		node = local;
+	}
+	if (node < 0 || (size_t)node >= sizeof(mask) * 8)
+		return CIRCBUF_ERROR;
+
+	mask[node / (sizeof(mask[0]) * 8)] |= 1UL << (node % (sizeof(mask[0]) * 8));
+	if (syscall(SYS_mbind, memory, size, 2, mask, sizeof(mask) * 8, 0) < 0)
+		return CIRCBUF_ERROR;
+
+	return CIRCBUF_OK;
+#else /* defined(__linux__) && defined(SYS_mbind) && defined(SYS_getcpu) */
+	(void)memory;
+	(void)size;
+
+	/*
+	 * Without NUMA support memory is local anyway.
+	 */
+	return (node == CIRCBUF_NODE_LOCAL) ? CIRCBUF_OK : CIRCBUF_ERROR;
+#endif /* defined(__linux__) && defined(SYS_mbind) && defined(SYS_getcpu) */
+}
+
+/*
+ * allocate the memory and initialize string buffer in it
+ *
+ * AI: HUGE PAGES ARE BEST EFFORT -- if none are reserved, transparent huge
+ *     pages are asked for instead
+ */
+int
+circstringbuf_create(circstringbuf_t *cb, size_t buffer_size, int node,
+	unsigned flags) {
+
+	if (!cb || !buffer_size)
+		return CIRCBUF_ERROR;
+
+size_t page = sysconf(_SC_PAGESIZE);
+size_t map_size = (buffer_size + page - 1) / page * page;
+char *memory = MAP_FAILED;
+
+#if defined(MAP_HUGETLB)
+	if (flags & CIRCBUF_HUGEPAGES) {
+
+size_t huge_size = (buffer_size + CIRCBUF_HUGEPAGE_SIZE - 1) /
+	CIRCBUF_HUGEPAGE_SIZE * CIRCBUF_HUGEPAGE_SIZE;
+
+		memory = mmap(NULL, huge_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (memory != MAP_FAILED) {
+
+			map_size = huge_size;
+			page = CIRCBUF_HUGEPAGE_SIZE;
+		}
+	}
+#endif /* defined(MAP_HUGETLB) */
+
+	if (memory == MAP_FAILED) {
+
+		memory = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED)
+			return CIRCBUF_ERROR;
+#if defined(MADV_HUGEPAGE)
+		if (flags & CIRCBUF_HUGEPAGES)
+			madvise(memory, map_size, MADV_HUGEPAGE);
+#endif /* defined(MADV_HUGEPAGE) */
+	}
+
+	/*
+	 * Memory is bound before it is touched, so the pages are allocated
+	 * where they belong.
+	 */
+	if (node != CIRCBUF_NODE_ANY &&
+		circstringbuf_bind(memory, map_size, node) != CIRCBUF_OK) {
+
+		munmap(memory, map_size);
+
+		return CIRCBUF_ERROR;
+	}
+
+	if (flags & CIRCBUF_PREFAULT) {
+
+		for (size_t offset = 0; offset < map_size; offset += page)
+			*(volatile char *)(memory + offset) = '\0';
+	}
+
+	if (circstringbuf_init(cb, memory, buffer_size) != CIRCBUF_OK) {
+
+		munmap(memory, map_size);
+
+		return CIRCBUF_ERROR;
+	}
+	cb->map_size = map_size;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * free the memory allocated by circstringbuf_create()
+ */
+int
+circstringbuf_destroy(circstringbuf_t *cb) {
+
+	if (!cb || !cb->map_size)
+		return CIRCBUF_ERROR;
+	if (munmap(cb->start, cb->map_size) < 0)
+		return CIRCBUF_ERROR;
+#if defined(CIRCBUF_LOCK) && CIRCBUF_LOCK != CIRCBUF_LOCK_NONE
+	circstringbuf_lock_fini(&cb->lock);
+#endif
+
+	cb->start = NULL;
+	cb->end = 0;
+	cb->map_size = 0;
+
+	return CIRCBUF_OK;
+}
+#endif /* defined(CIRCBUF_POSIX) */
@@ -31,12 +31,59 @@
 #	endif /* __has_include("config.h") */
 #endif /* defined(HAVE_CONFIG_H) */
 
+#if !defined(CIRCBUF_POSIX) && (defined(__unix__) || defined(__APPLE__))
+#	define CIRCBUF_POSIX 1
+#endif
+
 #include <stdint.h>
 #include <stdbool.h>
 
 #define CIRCBUF_SPACE_LEFT(__empty, __ce, __cs, __size) (__empty) ? __size: \
 	((__size + __cs - __ce) % __size)
 
+/*
+ * Lock backends, see circstringbuf_lock.h.
+ *
+ * Define CIRCBUF_LOCK to one of them (for the library and its users
+ * alike) for CIRCBUF_ACQUIRE/CIRCBUF_RELEASE to lock each buffer by its
+ * own lock, unless they are defined explicitly.
+ *
+ */
+#define CIRCBUF_LOCK_NONE 0
+#define CIRCBUF_LOCK_MUTEX 1
+#define CIRCBUF_LOCK_TICKET 2
+#define CIRCBUF_LOCK_ADAPTIVE 3
+
+/*
+ * CPU hint for the spin-wait loops, of the lock backends and of the
+ * spinlocks of the library.
+ *
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#	define CIRCBUF_LOCK_PAUSE __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#	define CIRCBUF_LOCK_PAUSE __asm__ __volatile__("yield")
+#else
+#	define CIRCBUF_LOCK_PAUSE {}
+#endif
+
+#if defined(CIRCBUF_LOCK) && CIRCBUF_LOCK != CIRCBUF_LOCK_NONE
+#	include "circstringbuf_lock.h"
+#	if !defined(CIRCBUF_ACQUIRE)
+#		define CIRCBUF_ACQUIRE circstringbuf_lock_acquire(&cb->lock)
+#	endif
+#	if !defined(CIRCBUF_RELEASE)
+#		define CIRCBUF_RELEASE circstringbuf_lock_release(&cb->lock)
+#	endif
+#endif
+
+/*
+ * Atomic load of the sequence counter, for the readers which take no
+ * lock (see circstringbuf_t).
+ *
+ */
+#define CIRCBUF_SEQ_LOAD(__seq) __atomic_load_n(&(__seq), __ATOMIC_ACQUIRE)
+
 /*
  * Thread-safety macros.
  *
@@ -51,6 +98,83 @@
 #	define CIRCBUF_RELEASE {}
 #endif
 
+/*
+ * Number of attempts circstringbuf_snapshot() does to get a copy nobody
+ * has overwritten before it trims the evicted prefix away.
+ *
+ */
+#if !defined(CIRCBUF_SNAPSHOT_RETRIES)
+#	define CIRCBUF_SNAPSHOT_RETRIES 4
+#endif
+
+/*
+ * Wait step of the producer pushing to the full buffer under CIRCBUF_BLOCK
+ * policy, called with no lock held.
+ *
+ */
+#if !defined(CIRCBUF_WAIT)
+#	if defined(CIRCBUF_POSIX)
+#		include <sched.h>
+#		define CIRCBUF_WAIT sched_yield()
+#	else /* defined(CIRCBUF_POSIX) */
+#		define CIRCBUF_WAIT {}
+#	endif /* defined(CIRCBUF_POSIX) */
+#endif
+
+/*
+ * Huge page size circstringbuf_create() rounds the allocation up to.
+ *
+ */
+#if !defined(CIRCBUF_HUGEPAGE_SIZE)
+#	define CIRCBUF_HUGEPAGE_SIZE (2 * 1024 * 1024)
+#endif
+
+/*
+ * circstringbuf_create() flags and NUMA nodes.
+ *
+ * CIRCBUF_HUGEPAGES            - back the buffer with huge pages
+ * CIRCBUF_PREFAULT             - touch all the pages in advance
+ * CIRCBUF_NODE_ANY             - don't bind the buffer to NUMA node
+ * CIRCBUF_NODE_LOCAL           - bind it to the node of the calling thread
+ *
+ */
+#define CIRCBUF_HUGEPAGES 1
+#define CIRCBUF_PREFAULT 2
+#define CIRCBUF_NODE_ANY -1
+#define CIRCBUF_NODE_LOCAL -2
+
+/*
+ * Number of the oldest strings CIRCBUF_PRIORITY policy chooses the one
+ * to evict from.
+ *
+ */
+#if !defined(CIRCBUF_PRIORITY_WINDOW)
+#	define CIRCBUF_PRIORITY_WINDOW 16
+#endif
+
+/*
+ * Priorities of strings are 0 (the lowest, evicted first) to
+ * CIRCBUF_PRIO_MAX, and are stored as the tag byte preceding each string
+ * of the buffer under CIRCBUF_PRIORITY policy.
+ *
+ */
+#define CIRCBUF_PRIO_MAX 15
+#define CIRCBUF_PRIO_TAG 0xF0
+
+/*
+ * Number of the multi-string groups committed the buffer keeps track of,
+ * so that eviction never splits them. Once there are more, the newest
+ * ones tracked are merged.
+ *
+ */
+#if !defined(CIRCBUF_GROUPS)
+#	define CIRCBUF_GROUPS 8
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
 /*
  * Status (proposed/acceptable and real) of circular string buffer library
  * operations.
@@ -61,10 +185,72 @@ typedef enum {
 	CIRCBUF_OK = 0,
 	CIRCBUF_EMPTY = -1,
 	CIRCBUF_ERROR = -2,
+	CIRCBUF_FULL = -3,
+	CIRCBUF_REJECTED = -4,
 	CIRCBUF_WRAP = 1,
 	CIRCBUF_DATALOSS = 2
 } circstringbufstatus_t;
 
+/*
+ * What circstringbuf_push() does when the string does not fit.
+ *
+ * CIRCBUF_DROP_OLDEST  - evict the oldest strings (default)
+ * CIRCBUF_DROP_NEWEST  - drop the string pushed, return CIRCBUF_FULL
+ * CIRCBUF_BLOCK        - wait by CIRCBUF_WAIT till the string fits
+ * CIRCBUF_PRIORITY     - evict the lowest priority strings first
+ *
+ */
+typedef enum {
+
+	CIRCBUF_DROP_OLDEST = 0,
+	CIRCBUF_DROP_NEWEST,
+	CIRCBUF_BLOCK,
+	CIRCBUF_PRIORITY
+} circstringbufpolicy_t;
+
+/*
+ * Overflow tier the strings evicted by circstringbuf_push() and
+ * circstringbuf_malloc() are handed over to instead of being lost, see
+ * circstringbuf_spill.h for the one spilling them to disk.
+ *
+ * @field put                   - store the strings evicted, given as one
+ *                                or two parts of the buffer (the second
+ *                                one is empty if there is no wrap),
+ *                                returns CIRCBUF_OK if they are stored
+ * @field get                   - take the oldest string stored, which ends
+ *                                with the delimiter of the buffer given:
+ *                                pop it to string if it is not NULL, else
+ *                                just store its length to *pSize if pSize
+ *                                is not NULL, else drop it; returns
+ *                                CIRCBUF_OK, CIRCBUF_EMPTY, or
+ *                                CIRCBUF_ERROR if the string is not
+ *                                terminated or cannot be read
+ * @field void *ctx             - the tier object passed to the both
+ *
+ * Both are called with the buffer locked.
+ *
+ */
+typedef struct {
+
+	int (*put)(void *ctx, const char *part1, size_t size1,
+		const char *part2, size_t size2);
+	int (*get)(void *ctx, char delim, char *string, size_t *pSize);
+	void *ctx;
+} circstringbuf_tier_t;
+
+/*
+ * Contiguous part of the buffer memory.
+ *
+ * @field char *data            - first byte, NULL if the part is empty
+ * @field size_t size           - number of bytes
+ *
+ */
+typedef struct {
+
+	char *data;
+	size_t size;
+} circstringbuf_segment_t;
+
 /*
  * Circular buffer control structure.
  *
@@ -74,6 +260,36 @@ typedef enum {
  *                                while buffer is partially freeing by pop()
  * @field size_t current_end    - current position of buffer end
  * @field bool empty            - self-explanatory
+ * @field uint64_t seq_start    - total number of bytes ever consumed or
+ *                                evicted, seq_start % end == current_start
+ * @field uint64_t seq_end      - total number of bytes ever pushed,
+ *                                seq_end % end == current_end
+ * @field uint64_t seq_pushed   - seq_end as of the last string written to
+ *                                the buffer by the library, the space
+ *                                circstringbuf_malloc() returns is not
+ *                                filled up to it yet
+ * @field enum policy           - overflow policy
+ * @field uint64_t dropped      - number of strings evicted or dropped
+ *                                because the buffer was full
+ * @field circstringbuf_tier_t *tier
+ *                              - overflow tier, NULL if there is none
+ * @field size_t map_size       - size of the memory mapped by
+ *                                circstringbuf_create(), 0 if buffer
+ *                                memory was supplied by the caller
+ * @field size_t stream         - minimum size of the string pushed with
+ *                                streaming stores, 0 if none is
+ * @field char delim            - delimiter the strings are terminated
+ *                                with in the buffer, '\0' by default
+ * @field uint64_t group[][2]   - sequence ranges of the groups committed,
+ *                                the oldest first
+ * @field size_t groups         - number of the groups tracked
+ * @field circstringbuf_lock_t lock
+ *                              - lock of the buffer, if CIRCBUF_LOCK
+ *                                selects the backend
+ *
+ * Sequence counters are updated atomically with release semantics (and
+ * seq_start before the bytes it has released are overwritten), so that
+ * lock-free readers are able to detect data overwritten under them.
  *
  */
 typedef struct {
@@ -84,8 +300,42 @@ typedef struct {
 	size_t current_start;
 	size_t current_end;
 	bool empty;
+
+	uint64_t seq_start;
+	uint64_t seq_end;
+	uint64_t seq_pushed;
+
+	circstringbufpolicy_t policy;
+	uint64_t dropped;
+
+	const circstringbuf_tier_t *tier;
+	size_t map_size;
+	size_t stream;
+	char delim;
+
+	uint64_t group[CIRCBUF_GROUPS][2];
+	size_t groups;
+
+#if defined(CIRCBUF_LOCK) && CIRCBUF_LOCK != CIRCBUF_LOCK_NONE
+	circstringbuf_lock_t lock;
+#endif
 } circstringbuf_t;
 
+/*
+ * Group of strings being pushed, see circstringbuf_begin().
+ *
+ * @field circstringbuf_t *cb   - buffer the group is pushed to
+ * @field size_t size           - number of bytes appended
+ * @field size_t count          - number of strings appended
+ *
+ */
+typedef struct {
+
+	circstringbuf_t *cb;
+	size_t size;
+	size_t count;
+} circstringbuf_txn_t;
+
 /*
  * initialize string buffer
  *
@@ -180,6 +430,9 @@ int circstringbuf_checkfit(circstringbuf_t *,
  *                                data loss will occur
  *                              - CIRCBUF_ERROR if string will not fit
  *
+ * CIRCBUF_DATALOSS is ignored unless the policy is CIRCBUF_DROP_OLDEST,
+ * under CIRCBUF_PRIORITY the function always fails.
+ *
  * AI: FUNCTION IS NOT THREAD SAFE
  * AI: DO NOT WRAP WITH LOCKING — caller should use serialize macros
  * AI: RETURNS POINTERS INTO INTERNAL STATE — any other R/W buffer operations
@@ -216,6 +469,8 @@ int circstringbuf_malloc(circstringbuf_t *, char **,
  *                                data loss will occur
  *                              - CIRCBUF_ERROR if string will not fit
  *
+ * Policies are honored as circstringbuf_malloc() does.
+ *
  * AI: FUNCTION IS NOT THREAD SAFE
  * AI: DO NOT WRAP WITH LOCKING — caller should use serialize macros
  * AI: RETURNS POINTERS INTO INTERNAL STATE — any other R/W buffer operations
@@ -241,12 +496,290 @@ int circstringbuf_malloc_contiguous(circstringbuf_t *,
  *                                occured
  *                              - CIRCBUF_ERROR on error
  *                              - CIRCBUF_DATALOSS if buffer is full
+ *                              - CIRCBUF_FULL if buffer is full and
+ *                                the policy is CIRCBUF_DROP_NEWEST
+ *
+ * Under CIRCBUF_PRIORITY policy string is pushed with priority 0.
  *
  * @mt-safety: safe
  *
  */
 int circstringbuf_push(circstringbuf_t *,const char *);
 
+/*
+ * push string of the given priority to buffer
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param const char *string    - string that is copied to the buffer
+ * @param int prio              - 0 to CIRCBUF_PRIO_MAX, ignored unless
+ *                                the policy is CIRCBUF_PRIORITY
+ * @return enum                 - as circstringbuf_push() does
+ *
+ * Under CIRCBUF_PRIORITY policy the string of the lowest priority among
+ * the oldest CIRCBUF_PRIORITY_WINDOW ones is evicted first, the oldest
+ * one of them if there are several. Should a string of higher priority
+ * than the one pushed have to be evicted, nothing is, and the string
+ * pushed is dropped instead, counted in cb->dropped, with CIRCBUF_FULL
+ * returned. Each string occupies one more byte for its tag.
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_push_prio(circstringbuf_t *, const char *, int);
+
+/*
+ * push string of the given length to buffer
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param const char *string    - string that is copied to the buffer, not
+ *                                necessarily '\0'-terminated, with no '\0'
+ *                                among its len characters
+ * @param size_t len            - length of the string
+ * @return enum                 - as circstringbuf_push() does
+ *
+ * The string is copied by memcpy() and terminated in the buffer, it is
+ * never scanned.
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_push_n(circstringbuf_t *, const char *, size_t);
+
+/*
+ * push the block of strings to buffer at once
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param const char *strings   - strings that are copied to the buffer,
+ *                                each '\0'-terminated, one after another
+ * @param size_t size           - size of the block
+ * @param size_t count          - number of strings in the block
+ * @return enum                 - as circstringbuf_push() does
+ *                              - CIRCBUF_ERROR if the policy is
+ *                                CIRCBUF_PRIORITY
+ *
+ * Strings are copied under one lock by one memcpy() and are published
+ * together. Under CIRCBUF_DROP_NEWEST policy the whole block is dropped
+ * if it does not fit.
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_push_bulk(circstringbuf_t *, const char *, size_t, size_t);
+
+/*
+ * callback writing the string for circstringbuf_push_fill()
+ *
+ * @param void *ctx             - argument given to circstringbuf_push_fill()
+ * @param char *part1           - first part of the space for the string
+ * @param size_t size1          - size of the first part
+ * @param char *part2           - second part, the beginning of the buffer,
+ *                                for the characters beyond size1
+ *
+ */
+typedef void (*circstringbuf_fill_t)(void *, char *, size_t, char *);
+
+/*
+ * push the string of the given length written by the callback to buffer
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param size_t len            - length of the string
+ * @param circstringbuf_fill_t fill - callback writing the len characters
+ * @param void *ctx             - argument passed to the callback
+ * @return enum                 - as circstringbuf_push() does
+ *
+ * For the front ends storing their own records (see circstringbuf_dedup.h,
+ * circstringbuf_shard.h): the space is allocated under the policy as
+ * circstringbuf_push_n() does it, CIRCBUF_BLOCK waiting included, then
+ * the callback is called under the lock and the string is terminated and
+ * published.
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_push_fill(circstringbuf_t *, size_t, circstringbuf_fill_t,
+	void *);
+
+/*
+ * format the value as the given number of lowercase hex digits
+ *
+ * @param char *digits          - count characters written, not terminated
+ * @param size_t count          - number of digits, the higher ones of the
+ *                                value are cut off
+ * @param uint64_t value        - value to format
+ *
+ * @mt-safety: safe
+ *
+ */
+void circstringbuf_hex(char *, size_t, uint64_t);
+
+/*
+ * nanoseconds of monotonic clock
+ *
+ * @return uint64_t             - clock value, of the wall clock if
+ *                                CIRCBUF_POSIX is not defined
+ *
+ * @mt-safety: safe
+ *
+ */
+uint64_t circstringbuf_now(void);
+
+/*
+ * begin the group of strings pushed to buffer at once
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param circstringbuf_txn_t *txn
+ *                              - group object
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error, or if the policy
+ *                                is CIRCBUF_PRIORITY
+ *
+ * Strings appended to the group are written past the buffer end and are
+ * neither popped nor seen by lock-free readers until the group is
+ * committed; the buffer end is published once for all of them then.
+ * Eviction drops the group committed as a whole.
+ *
+ * AI: FUNCTION IS NOT THREAD SAFE
+ * AI: DO NOT WRAP WITH LOCKING — caller should use serialize macros around
+ *     the whole group, from circstringbuf_begin() to circstringbuf_commit()
+ *
+ * @mt-safety: unsafe           - no other operation on the buffer may
+ *                                take place till the group is committed
+ *                                or aborted
+ *
+ */
+int circstringbuf_begin(circstringbuf_t *, circstringbuf_txn_t *);
+
+/*
+ * append string to the group
+ *
+ * @param circstringbuf_txn_t *txn
+ *                              - group object
+ * @param const char *string    - string that is copied to the buffer
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_DATALOSS if the oldest strings
+ *                                were evicted to fit the string
+ *                              - CIRCBUF_FULL if the string does not fit
+ *                                and the policy forbids eviction, nothing
+ *                                is appended then
+ *                              - CIRCBUF_ERROR on error, or if the group
+ *                                would not fit into the empty buffer
+ *
+ * Under CIRCBUF_BLOCK policy the function does not wait, since the caller
+ * holds the buffer: abort the group and retry it.
+ *
+ * @mt-safety: unsafe           - see circstringbuf_begin()
+ *
+ */
+int circstringbuf_append(circstringbuf_txn_t *, const char *);
+
+/*
+ * make all the strings of the group visible at once
+ *
+ * @param circstringbuf_txn_t *txn
+ *                              - group object
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: unsafe           - see circstringbuf_begin()
+ *
+ */
+int circstringbuf_commit(circstringbuf_txn_t *);
+
+/*
+ * discard all the strings of the group
+ *
+ * @param circstringbuf_txn_t *txn
+ *                              - group object
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * Strings evicted to fit the group are not restored.
+ *
+ * @mt-safety: unsafe           - see circstringbuf_begin()
+ *
+ */
+int circstringbuf_abort(circstringbuf_txn_t *);
+
+/*
+ * set the overflow policy
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param enum policy           - policy to set
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error, or if buffer is
+ *                                not empty and the policy is switched to
+ *                                or from CIRCBUF_PRIORITY
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_set_policy(circstringbuf_t *, circstringbufpolicy_t);
+
+/*
+ * copy long strings pushed bypassing the cache
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param size_t threshold      - minimum size of the string, including
+ *                                its '\0', copied with streaming stores,
+ *                                0 to copy all of them as usual
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * For buffers written constantly and read rarely: circstringbuf_push()
+ * copies strings with SSE2 non-temporal stores, fenced before the string
+ * is published, so they don't evict the application's working set from
+ * the cache. Where SSE2 is not available strings are copied as usual.
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_set_streaming(circstringbuf_t *, size_t);
+
+/*
+ * set the delimiter the strings are terminated with in the buffer
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param char delim            - delimiter, e.g. '\n' for the buffer
+ *                                contents to be the text log as it is
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error, or if buffer is
+ *                                not empty and the delimiter differs
+ *
+ * The delimiter replaces '\0' inside the buffer only: strings pushed are
+ * C strings (and a delimiter inside one splits it in two), strings popped,
+ * peeked and spanned are C strings; the space allocated by
+ * circstringbuf_malloc() is to be terminated with the delimiter, blocks of
+ * circstringbuf_push_bulk() too. The dump and the snapshot are the buffer
+ * contents, i.e. delimited.
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_set_delimiter(circstringbuf_t *, char);
+
+/*
+ * attach the overflow tier to the buffer
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param circstringbuf_tier_t *tier
+ *                              - tier to attach, NULL to detach
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * Once attached, the strings CIRCBUF_DROP_OLDEST policy evicts go to
+ * the tier, and circstringbuf_pop(), circstringbuf_strlen() and
+ * circstringbuf_drop() take strings from the tier before the ones stored
+ * in the buffer, so the order is kept. Eviction is still to be allowed
+ * by CIRCBUF_DATALOSS flag of circstringbuf_malloc(), but it is only
+ * reported if the tier fails to store the strings. Strings the tier holds
+ * are neither spanned nor included in the snapshot or dump. Detach the
+ * tier once it is drained only.
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_set_tier(circstringbuf_t *, const circstringbuf_tier_t *);
+
 /*
  * return the length of string to be popped by the next circstringbuf_pop()
  *
@@ -277,6 +810,51 @@ int circstringbuf_strlen(circstringbuf_t *, size_t *);
  */
 int circstringbuf_pop(circstringbuf_t *, char *);
 
+/*
+ * pop string from circular buffer to the buffer of the size given
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param char *string          - string where the first valid element is
+ *                                copied to
+ * @param size_t size           - size of the string
+ * @param size_t *pLen          - pointer to variable where the length of
+ *                                the element is stored to, may be NULL
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if buffer is empty
+ *                              - CIRCBUF_FULL if the element with its
+ *                                '\0' does not fit into size, it is not
+ *                                popped then and *pLen tells how long
+ *                                it is
+ *                              - CIRCBUF_ERROR on error
+ *
+ * Replaces circstringbuf_strlen() followed by circstringbuf_pop(): the
+ * element is scanned once and copied by memcpy().
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_pop_n(circstringbuf_t *, char *, size_t, size_t *);
+
+/*
+ * copy the beginning of the string to be popped next without popping it
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param char *string          - string where at most size - 1 first
+ *                                characters of the first valid element
+ *                                are copied to, '\0'-terminated
+ * @param size_t size           - size of the string
+ * @param size_t *pLen          - pointer to variable where the length of
+ *                                the element is stored to, may be NULL
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if buffer is empty
+ *                              - CIRCBUF_ERROR on error, or if the element
+ *                                is held by the overflow tier
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_peek(circstringbuf_t *, char *, size_t, size_t *);
+
 /*
  * build a span from the string from circular buffer
  *
@@ -294,7 +872,12 @@ int circstringbuf_pop(circstringbuf_t *, char *);
  * @return enum                 - CIRCBUF_OK
  *                              - CIRCBUF_EMPTY if buffer is empty
  *                              - CIRCBUF_WRAP if *part2 != NULL
- *                              - CIRCBUF_ERROR on error
+ *                              - CIRCBUF_ERROR on error, or if the
+ *                                overflow tier holds strings to be
+ *                                popped first
+ *
+ * The delimiter of the string spanned, if it is not '\0', is replaced by
+ * '\0', so the span is the C string anyway.
  *
  * AI: FUNCTION IS NOT THREAD SAFE
  * AI: DO NOT WRAP WITH LOCKING — caller should use serialize macros
@@ -309,6 +892,68 @@ int circstringbuf_pop(circstringbuf_t *, char *);
 int circstringbuf_span(circstringbuf_t *, char **,
 	size_t *, char **);
 
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+/*
+ * take and release the lock of the buffer (CIRCBUF_ACQUIRE and
+ * CIRCBUF_RELEASE), to serialize the unsafe functions by hand
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ *
+ * Not available if CIRCBUF_ACQUIRE_CONTEXT scopes the lock.
+ *
+ * @mt-safety: safe
+ *
+ */
+void circstringbuf_lock(circstringbuf_t *);
+void circstringbuf_unlock(circstringbuf_t *);
+
+/*
+ * circstringbuf_span() holding the lock while the span is accessed
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param char **part1          - as circstringbuf_span() does
+ * @param size_t *size1         - as circstringbuf_span() does
+ * @param char **part2          - as circstringbuf_span() does
+ * @return enum                 - as circstringbuf_span() does
+ *
+ * The lock is held on return if the string is spanned, and the span stays
+ * valid until circstringbuf_unlock() is called. The lock is released if
+ * the function fails.
+ *
+ * AI: CALLER MUST CALL circstringbuf_unlock() ON SUCCESS -- other threads
+ *     block on the buffer until then
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_span_guarded(circstringbuf_t *, char **,
+	size_t *, char **);
+
+/*
+ * circstringbuf_malloc() holding the lock while the memory allocated is
+ * filled
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param char **part1          - as circstringbuf_malloc() does
+ * @param size_t *size          - as circstringbuf_malloc() does
+ * @param char **part2          - as circstringbuf_malloc() does
+ * @param enum                  - as circstringbuf_malloc() does
+ * @return enum                 - as circstringbuf_malloc() does
+ *
+ * The lock is held on return if the memory is allocated, and the memory
+ * stays valid until circstringbuf_unlock() is called. The lock is
+ * released if the function fails.
+ *
+ * AI: CALLER MUST CALL circstringbuf_unlock() ON SUCCESS -- other threads
+ *     block on the buffer until then
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_malloc_guarded(circstringbuf_t *, char **,
+	size_t *, char **, circstringbufstatus_t);
+#endif /* !defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
 /*
  * pop string from circular buffer to nowhere (i.e, drop it away)
  *
@@ -322,3 +967,230 @@ int circstringbuf_span(circstringbuf_t *, char **,
  */
 int circstringbuf_drop(circstringbuf_t *);
 
+/*
+ * free up the bytes at the buffer start consumed by the caller directly
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param size_t size           - number of bytes consumed
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error, or if there is
+ *                                less data stored
+ *
+ * Lets consumers reading the buffer memory in place, e.g. by the sequence
+ * counters, to release it once they are done; size has to cover whole
+ * strings.
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_advance(circstringbuf_t *, size_t);
+
+/*
+ * get the oldest strings in place without consuming them
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param size_t max_records    - maximum number of strings
+ * @param size_t max_bytes      - maximum number of bytes
+ * @param circstringbuf_segment_t *seg1
+ *                              - variable set to the first part of the
+ *                                strings
+ * @param circstringbuf_segment_t *seg2
+ *                              - variable set to the second part of the
+ *                                strings if they wrap, empty otherwise
+ * @param size_t *pCount        - variable set to the number of strings
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if buffer is empty
+ *                              - CIRCBUF_FULL if the oldest string alone
+ *                                exceeds max_bytes, *pCount is 0 then
+ *                              - CIRCBUF_ERROR on error, if the policy is
+ *                                CIRCBUF_PRIORITY, or if the overflow tier
+ *                                holds strings to be popped first
+ *
+ * Segments cover whole strings with their delimiters, as they are stored.
+ * Nothing is consumed until circstringbuf_consume() is called, so the
+ * strings may be processed (sent, written) and retried in place.
+ *
+ * AI: RETURNS POINTERS INTO INTERNAL STATE — they stay valid until the
+ *     strings are consumed, unless CIRCBUF_DROP_OLDEST policy evicts them
+ *     meanwhile: hold them under CIRCBUF_DROP_NEWEST or CIRCBUF_BLOCK
+ *
+ * @mt-safety: safe             - for one consumer at a time
+ *
+ */
+int circstringbuf_peek_bulk(circstringbuf_t *, size_t, size_t,
+	circstringbuf_segment_t *, circstringbuf_segment_t *, size_t *);
+
+/*
+ * consume the oldest strings, e.g. the ones circstringbuf_peek_bulk() got
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param size_t count          - number of strings
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error, or if there are
+ *                                less strings stored, nothing is consumed
+ *                                then
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_consume(circstringbuf_t *, size_t);
+
+/*
+ * copy all the strings stored in the buffer without locking it
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param char *buffer          - buffer the snapshot is copied to, strings
+ *                                are stored one by one, each '\0'-termi-
+ *                                nated, oldest first
+ * @param size_t buffer_size    - size of the buffer, if it is smaller than
+ *                                the data stored only the newest strings
+ *                                fitting into it are copied
+ * @param size_t *pSize         - pointer to variable where the size of
+ *                                the snapshot is stored to
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if buffer is empty
+ *                              - CIRCBUF_DATALOSS if the oldest strings
+ *                                have not fit into the buffer
+ *                              - CIRCBUF_ERROR on error
+ *
+ * Producers are never stopped: cursors are read through the sequence
+ * counters, the data is copied with no more than two memcpy()s, and then
+ * the copy is verified against the strings evicted meanwhile. If some
+ * were, the copy is retried up to CIRCBUF_SNAPSHOT_RETRIES times, then
+ * the overwritten strings are trimmed off the head of the snapshot.
+ * Under CIRCBUF_PRIORITY policy strings are copied with their tags.
+ * The snapshot ends at the last string pushed: the space allocated by
+ * circstringbuf_malloc() after it is only included once another string
+ * is pushed, so it has to be filled up by then.
+ *
+ * @mt-safety: safe             - lock-free, may run concurrently with any
+ *                                operation except of buffer re-initiali-
+ *                                zation
+ *
+ */
+int circstringbuf_snapshot(circstringbuf_t *, char *,
+	size_t, size_t *);
+
+/*
+ * move the strings stored to the beginning of the buffer
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * Once linearized, current_start is 0 and all the strings stored occupy
+ * one contiguous part of the buffer. Buffer is rotated in place, which
+ * takes time proportional to the buffer size.
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_linearize(circstringbuf_t *);
+
+/*
+ * move the strings stored to the new buffer of the different size
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param char *buffer          - new static character buffer
+ * @param size_t buffer_size    - size of new buffer
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_DATALOSS if the oldest strings
+ *                                have not fit into the new buffer and
+ *                                were dropped
+ *                              - CIRCBUF_ERROR on error
+ *
+ * Strings are stored linearized in the new buffer, i.e. current_start is
+ * 0. The bulk of the data is copied without locking the buffer the way
+ * circstringbuf_snapshot() does, so producers keep pushing meanwhile;
+ * the lock is only held to copy the strings they have pushed during
+ * the copying. The old buffer is not used once the function returns.
+ * Buffers allocated by circstringbuf_create() are not resized.
+ *
+ * @mt-safety: safe             - except concurrent circstringbuf_snapshot()
+ *                                and circstringbuf_dump_fd(), which may
+ *                                still read the old buffer
+ *
+ */
+int circstringbuf_resize(circstringbuf_t *, char *, size_t);
+
+#if defined(CIRCBUF_POSIX)
+/*
+ * write all the strings stored in the buffer to the file descriptor
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param int fd                - file descriptor to write to
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if buffer is empty
+ *                              - CIRCBUF_DATALOSS if write() was short
+ *                              - CIRCBUF_ERROR on error
+ *
+ * Strings are written as they are stored, i.e. '\0'-separated, with no
+ * more than two write() calls. The function neither locks the buffer nor
+ * allocates memory, so it may be called from a signal handler even if
+ * some producer was interrupted in the middle of the push: the string
+ * being pushed is just not written. Nor is the space allocated by
+ * circstringbuf_malloc() after the last string pushed, as with
+ * circstringbuf_snapshot().
+ *
+ * @mt-safety: async-signal-safe
+ *
+ */
+int circstringbuf_dump_fd(circstringbuf_t *, int);
+
+/*
+ * dump the buffer by circstringbuf_dump_fd() on fatal signals
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param int fd                - file descriptor to write to
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * Handlers are installed for SIGSEGV, SIGBUS, SIGILL, SIGFPE and SIGABRT,
+ * once the buffer is dumped the signal is re-raised with its default
+ * disposition. The only one buffer may be registered, the latest call
+ * wins.
+ *
+ * @mt-safety: unsafe           - installs process-wide signal handlers
+ *
+ */
+int circstringbuf_dump_on_signal(circstringbuf_t *, int);
+
+/*
+ * allocate the memory and initialize string buffer in it
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param size_t buffer_size    - size of buffer
+ * @param int node              - NUMA node to bind the memory to,
+ *                                CIRCBUF_NODE_ANY or CIRCBUF_NODE_LOCAL
+ * @param unsigned flags        - CIRCBUF_HUGEPAGES, CIRCBUF_PREFAULT
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * Memory is mapped anonymously. With CIRCBUF_HUGEPAGES huge pages
+ * reserved are used if there are enough, transparent huge pages are
+ * asked for otherwise. With CIRCBUF_PREFAULT pages are touched (after
+ * binding) so the first pushes don't fault.
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_create(circstringbuf_t *, size_t, int, unsigned);
+
+/*
+ * free the memory allocated by circstringbuf_create()
+ *
+ * @param circstringbuf_t *cb   - circbuffer object created
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error, or if buffer
+ *                                was not created by circstringbuf_create()
+ *
+ * @mt-safety: unsafe           - no operation on the buffer may be
+ *                                in progress
+ *
+ */
+int circstringbuf_destroy(circstringbuf_t *);
+#endif /* defined(CIRCBUF_POSIX) */
+
+#if defined(__cplusplus)
+}
+#endif
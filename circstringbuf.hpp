@@ -0,0 +1,398 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+#include "circstringbuf.h"
+
+namespace circstringbuf {
+
+/*
+ * Scheduler hook resuming the coroutine the buffer wakes up.
+ *
+ * It is called with no lock held on the thread which made the data (or
+ * the space) available, i.e. by push() for the consumer, by try_pop() or
+ * pop() for the producer. With no hook the coroutine is resumed right
+ * there, with no thread handoff; an executor posts it to its own queue
+ * instead.
+ *
+ */
+using resume_t = void (*)(std::coroutine_handle<>, void *ctx);
+
+/*
+ * Circular buffer with awaitable pop() and reserve().
+ *
+ * The object does not own the circstringbuf_t, which is locked by
+ * CIRCBUF_ACQUIRE/CIRCBUF_RELEASE as usual; waiters are kept under the
+ * mutex of its own. Coroutines are woken by the methods of this object
+ * only: if the buffer is used through the C functions as well, call
+ * notify() after that.
+ *
+ * AI: ONE-SHOT WAKE-UP -- the data popped for the waiting consumer is
+ *     taken by push() under the waiters lock, so that nobody steals it
+ *     between the wake-up and the resumption
+ *
+ */
+class buffer {
+
+	struct waiter {
+
+		waiter *next = nullptr;
+		std::coroutine_handle<> handle;
+		std::string *string = nullptr;
+		size_t size = 0;
+	};
+
+	struct queue {
+
+		waiter *head = nullptr;
+		waiter *tail = nullptr;
+
+		void push(waiter *w) {
+
+			w->next = nullptr;
+			if (tail)
+				tail->next = w;
+			else
+				head = w;
+			tail = w;
+		}
+
+		waiter *pop() {
+
+		waiter *w = head;
+
+			head = w->next;
+			if (!head)
+				tail = nullptr;
+
+			return w;
+		}
+	};
+
+public:
+
+	/*
+	 * awaiter of the string, co_await returns it
+	 */
+	class pop_awaiter {
+
+	public:
+
+		explicit pop_awaiter(buffer &buf) : buf_(buf) {}
+
+		bool await_ready() {
+
+			if (buf_.take(string_) != CIRCBUF_OK)
+				return false;
+			buf_.wake_reserves();
+
+			return true;
+		}
+
+		bool await_suspend(std::coroutine_handle<> handle) {
+
+			{
+			std::lock_guard<std::mutex> lock(buf_.mutex_);
+
+				buf_.waiting_.fetch_add(1);
+				if (buf_.take(string_) != CIRCBUF_OK) {
+
+					waiter_.handle = handle;
+					waiter_.string = &string_;
+					buf_.pops_.push(&waiter_);
+
+					return true;
+				}
+				buf_.waiting_.fetch_sub(1);
+			}
+
+			/*
+			 * The space freed is offered to the producers outside the
+			 * waiters lock, which wake_reserves() takes.
+			 */
+			buf_.wake_reserves();
+
+			return false;
+		}
+
+		std::string await_resume() {
+
+			return std::move(string_);
+		}
+
+	private:
+
+		buffer &buf_;
+		std::string string_;
+		waiter waiter_;
+	};
+
+	/*
+	 * awaiter of the free space, co_await returns CIRCBUF_OK, or
+	 * CIRCBUF_ERROR if the size never fits
+	 */
+	class reserve_awaiter {
+
+	public:
+
+		reserve_awaiter(buffer &buf, size_t size) : buf_(buf), size_(size) {}
+
+		bool await_ready() {
+
+			return buf_.fits(size_) || size_ > buf_.cb_->end;
+		}
+
+		bool await_suspend(std::coroutine_handle<> handle) {
+
+		std::lock_guard<std::mutex> lock(buf_.mutex_);
+
+			buf_.waiting_.fetch_add(1);
+			if (buf_.fits(size_)) {
+
+				buf_.waiting_.fetch_sub(1);
+
+				return false;
+			}
+
+			waiter_.handle = handle;
+			waiter_.size = size_;
+			buf_.reserves_.push(&waiter_);
+
+			return true;
+		}
+
+		int await_resume() {
+
+			return (size_ > buf_.cb_->end) ? CIRCBUF_ERROR : CIRCBUF_OK;
+		}
+
+	private:
+
+		buffer &buf_;
+		size_t size_;
+		waiter waiter_;
+	};
+
+	explicit buffer(circstringbuf_t *cb, resume_t resume = nullptr,
+		void *ctx = nullptr) : cb_(cb), resume_(resume), ctx_(ctx) {}
+
+	buffer(const buffer &) = delete;
+	buffer &operator=(const buffer &) = delete;
+
+	circstringbuf_t *get() const {
+
+		return cb_;
+	}
+
+	/*
+	 * push string, resume the consumer waiting if any
+	 */
+	int push(const char *string) {
+
+	int result = circstringbuf_push(cb_, string);
+
+		if (result == CIRCBUF_OK || result == CIRCBUF_DATALOSS)
+			wake_pops();
+
+		return result;
+	}
+
+	/*
+	 * push string of the given length, see circstringbuf_push_n()
+	 */
+	int push_n(const char *string, size_t len) {
+
+	int result = circstringbuf_push_n(cb_, string, len);
+
+		if (result == CIRCBUF_OK || result == CIRCBUF_DATALOSS)
+			wake_pops();
+
+		return result;
+	}
+
+	/*
+	 * pop string if there is any, resume the producers waiting for space
+	 */
+	int try_pop(std::string &string) {
+
+	int result = take(string);
+
+		if (result == CIRCBUF_OK)
+			wake_reserves();
+
+		return result;
+	}
+
+	/*
+	 * co_await buf.pop() suspends until there is a string
+	 */
+	pop_awaiter pop() {
+
+		return pop_awaiter(*this);
+	}
+
+	/*
+	 * co_await buf.reserve(size) suspends until size bytes are free
+	 *
+	 * Under CIRCBUF_DROP_OLDEST and CIRCBUF_PRIORITY policies space is
+	 * made by eviction, so it never suspends. The space is not held: the
+	 * push following may still get CIRCBUF_FULL if another producer has
+	 * taken it, await again then.
+	 */
+	reserve_awaiter reserve(size_t size) {
+
+		return reserve_awaiter(*this, size);
+	}
+
+	/*
+	 * wake the waiters up after the buffer was used by the C functions
+	 */
+	void notify() {
+
+		wake_pops();
+		wake_reserves();
+	}
+
+private:
+
+	/*
+	 * pop string sized by the string length
+	 */
+	int take(std::string &string) {
+
+	size_t len = 0;
+
+		for (;;) {
+
+		int result = circstringbuf_strlen(cb_, &len);
+
+			if (result != CIRCBUF_OK)
+				return result;
+
+			string.resize(len);
+			result = circstringbuf_pop_n(cb_, string.data(), len + 1, &len);
+			if (result != CIRCBUF_FULL) {
+
+				if (result == CIRCBUF_OK)
+					string.resize(len);
+
+				return result;
+			}
+		}
+	}
+
+	/*
+	 * check if size bytes may be pushed with no data loss
+	 *
+	 * AI: NO BUFFER LOCK IS TAKEN -- the free space is derived from the
+	 *     sequence counters, start loaded first, so that it is never
+	 *     overestimated
+	 */
+	bool fits(size_t size) const {
+
+		if (cb_->policy == CIRCBUF_DROP_OLDEST ||
+			cb_->policy == CIRCBUF_PRIORITY)
+			return true;
+
+	uint64_t start = CIRCBUF_SEQ_LOAD(cb_->seq_start);
+	uint64_t used = CIRCBUF_SEQ_LOAD(cb_->seq_end) - start;
+
+		return used <= cb_->end && size <= cb_->end - used;
+	}
+
+	void resume(std::coroutine_handle<> handle) {
+
+		if (resume_)
+			resume_(handle, ctx_);
+		else
+			handle.resume();
+	}
+
+	/*
+	 * AI: WAITERS ARE RESUMED OUTSIDE THE LOCK -- a coroutine resumed
+	 *     inline may push, pop and await again
+	 */
+	void wake_pops() {
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!waiting_.load())
+			return;
+
+		for (;;) {
+
+		waiter *w = nullptr;
+
+			{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+				if (!pops_.head || take(*pops_.head->string) != CIRCBUF_OK)
+					break;
+				w = pops_.pop();
+				waiting_.fetch_sub(1);
+			}
+
+			resume(w->handle);
+			wake_reserves();
+		}
+	}
+
+	void wake_reserves() {
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!waiting_.load())
+			return;
+
+		for (;;) {
+
+		waiter *w = nullptr;
+
+			{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+				if (!reserves_.head || !fits(reserves_.head->size))
+					break;
+				w = reserves_.pop();
+				waiting_.fetch_sub(1);
+			}
+
+			resume(w->handle);
+		}
+	}
+
+	circstringbuf_t *cb_;
+	resume_t resume_;
+	void *ctx_;
+
+	std::mutex mutex_;
+	std::atomic<size_t> waiting_{0};	/* both queues */
+	queue pops_;
+	queue reserves_;
+};
+
+} /* namespace circstringbuf */
@@ -0,0 +1,148 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include "circstringbuf_admit.h"
+
+/*
+ * fill level of the buffer, percents, read lock-free from the sequence
+ * counters
+ *
+ * AI: FILL LEVEL IS READ WITHOUT LOCKING -- the decision is a heuristic,
+ *     an outdated fill level only shifts the moment rejection starts
+ * AI: COUNTERS MAY BE SEEN MID RE-BASE -- the level is clamped to 0..100
+ */
+static int
+circstringbuf_admit_level(const circstringbuf_t *cb) {
+uint64_t head = CIRCBUF_SEQ_LOAD(cb->seq_start);
+uint64_t tail = CIRCBUF_SEQ_LOAD(cb->seq_pushed);
+size_t end = cb->end;
+
+	if (tail <= head || !end)
+		return 0;
+	if (tail - head >= end)
+		return 100;
+
+	return (int)((tail - head) * 100 / end);
+}
+
+/*
+ * initialize admission control
+ */
+int
+circstringbuf_admit_init(circstringbuf_admit_t *admit, int watermark,
+	uint32_t sample) {
+
+	if (!admit || watermark < 0 || watermark > 100)
+		return CIRCBUF_ERROR;
+
+	memset(admit, 0, sizeof(*admit));
+	admit->watermark = watermark;
+	admit->sample = sample;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * limit pushes above the watermark by per-producer token buckets
+ */
+int
+circstringbuf_admit_bucket(circstringbuf_admit_t *admit, uint32_t rate,
+	uint32_t burst) {
+
+	if (!admit || (rate && !burst))
+		return CIRCBUF_ERROR;
+
+	admit->rate = rate;
+	admit->burst = burst;
+
+uint64_t now = circstringbuf_now() / 1000000;
+
+	for (int i = 0; i < CIRCBUF_ADMIT_PRODUCERS; i++) {
+
+		admit->buckets[i].tokens = (uint64_t)burst * 1000;
+		admit->buckets[i].stamp = now;
+	}
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * decide if the producer may push to the buffer now
+ *
+ * AI: BUFFER IS NOT LOCKED -- only the push admitted takes the lock
+ */
+int
+circstringbuf_admit_check(circstringbuf_admit_t *admit, circstringbuf_t *cb,
+	unsigned producer) {
+
+	if (!admit || !cb || producer >= CIRCBUF_ADMIT_PRODUCERS)
+		return CIRCBUF_ERROR;
+
+	if (circstringbuf_admit_level(cb) < admit->watermark)
+		return CIRCBUF_OK;
+
+uint64_t seen = __atomic_fetch_add(&admit->seen, 1, __ATOMIC_RELAXED);
+bool admitted = admit->sample <= 1 || seen % admit->sample == 0;
+
+	if (admitted && admit->rate) {
+
+circstringbuf_bucket_t *bucket = &admit->buckets[producer];
+uint64_t now = circstringbuf_now() / 1000000;
+
+		/*
+		 * rate tokens per second is rate thousandths of a token
+		 * per millisecond, the wall clock may step back though
+		 */
+		if (now > bucket->stamp)
+			bucket->tokens += (now - bucket->stamp) * admit->rate;
+		bucket->stamp = now;
+		if (bucket->tokens > (uint64_t)admit->burst * 1000)
+			bucket->tokens = (uint64_t)admit->burst * 1000;
+
+		admitted = bucket->tokens >= 1000;
+		if (admitted)
+			bucket->tokens -= 1000;
+	}
+
+	if (admitted)
+		return CIRCBUF_OK;
+
+	__atomic_fetch_add(&admit->rejected, 1, __ATOMIC_RELAXED);
+
+	return CIRCBUF_REJECTED;
+}
+
+/*
+ * push string to buffer if admission control admits it
+ */
+int
+circstringbuf_admit_push(circstringbuf_admit_t *admit, circstringbuf_t *cb,
+	unsigned producer, const char *string) {
+int result = circstringbuf_admit_check(admit, cb, producer);
+
+	if (result != CIRCBUF_OK)
+		return result;
+
+	return circstringbuf_push(cb, string);
+}
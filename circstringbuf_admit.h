@@ -0,0 +1,167 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "circstringbuf.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Number of producer IDs token buckets are kept for, IDs are 0 to this
+ * number less one.
+ *
+ */
+#if !defined(CIRCBUF_ADMIT_PRODUCERS)
+#	define CIRCBUF_ADMIT_PRODUCERS 16
+#endif
+
+/*
+ * Token bucket of one producer.
+ *
+ * @field uint64_t tokens       - tokens available, in 1/1000 of a token
+ * @field uint64_t stamp        - time of the last refill, ms
+ *
+ */
+typedef struct {
+
+	uint64_t tokens;
+	uint64_t stamp;
+} circstringbuf_bucket_t;
+
+/*
+ * Admission control of the pushes to the circular buffer.
+ *
+ * While the buffer fill level stays below the watermark every push is
+ * admitted. Above it pushes are sampled 1-in-N and/or limited by token
+ * buckets of the producers, the rest is rejected before the buffer is
+ * touched, i.e. before the eviction of older strings starts.
+ *
+ * @field int watermark         - fill level, percents, admission control
+ *                                starts from (const)
+ * @field uint32_t sample       - admit 1 of this many pushes, 0 or 1 if
+ *                                pushes are not sampled (const)
+ * @field uint32_t rate         - tokens added to each bucket per second,
+ *                                0 if buckets are not used (const)
+ * @field uint32_t burst        - bucket capacity, tokens (const)
+ * @field uint64_t seen         - number of pushes above the watermark
+ * @field uint64_t rejected     - number of pushes rejected
+ * @field circstringbuf_bucket_t buckets[]
+ *                              - token buckets, one per producer ID
+ *
+ */
+typedef struct {
+
+	int watermark;
+	uint32_t sample;
+	uint32_t rate;
+	uint32_t burst;
+
+	uint64_t seen;
+	uint64_t rejected;
+
+	circstringbuf_bucket_t buckets[CIRCBUF_ADMIT_PRODUCERS];
+} circstringbuf_admit_t;
+
+/*
+ * initialize admission control
+ *
+ * @param circstringbuf_admit_t *admit
+ *                              - static admission control object
+ * @param int watermark         - fill level, percents, to start from
+ * @param uint32_t sample       - admit 1 of this many pushes above the
+ *                                watermark, 0 to admit all of them
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: unsafe
+ *
+ */
+int circstringbuf_admit_init(circstringbuf_admit_t *, int, uint32_t);
+
+/*
+ * limit pushes above the watermark by per-producer token buckets
+ *
+ * @param circstringbuf_admit_t *admit
+ *                              - admission control object
+ * @param uint32_t rate         - tokens per second, i.e. pushes per
+ *                                second each producer is allowed, 0 to
+ *                                turn buckets off
+ * @param uint32_t burst        - bucket capacity, at least 1
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * Buckets start full.
+ *
+ * @mt-safety: unsafe
+ *
+ */
+int circstringbuf_admit_bucket(circstringbuf_admit_t *, uint32_t,
+	uint32_t);
+
+/*
+ * decide if the producer may push to the buffer now
+ *
+ * @param circstringbuf_admit_t *admit
+ *                              - admission control object
+ * @param circstringbuf_t *cb   - circbuffer object pushed to
+ * @param unsigned producer     - producer ID, less than
+ *                                CIRCBUF_ADMIT_PRODUCERS
+ * @return enum                 - CIRCBUF_OK if push is admitted
+ *                              - CIRCBUF_REJECTED if it is not
+ *                              - CIRCBUF_ERROR on error, or if producer
+ *                                ID is out of range
+ *
+ * Lets to guard circstringbuf_malloc() and friends the same way
+ * circstringbuf_admit_push() guards circstringbuf_push().
+ *
+ * @mt-safety: safe             - as long as each producer ID is used by
+ *                                one thread at a time
+ *
+ */
+int circstringbuf_admit_check(circstringbuf_admit_t *, circstringbuf_t *,
+	unsigned);
+
+/*
+ * push string to buffer if admission control admits it
+ *
+ * @param circstringbuf_admit_t *admit
+ *                              - admission control object
+ * @param circstringbuf_t *cb   - circbuffer object
+ * @param unsigned producer     - producer ID
+ * @param const char *string    - string that is copied to the buffer
+ * @return enum                 - CIRCBUF_REJECTED if push is not admitted
+ *                              - as circstringbuf_push() does otherwise
+ *
+ * @mt-safety: safe             - as circstringbuf_admit_check() is
+ *
+ */
+int circstringbuf_admit_push(circstringbuf_admit_t *, circstringbuf_t *,
+	unsigned, const char *);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,360 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include "circstringbuf_dedup.h"
+
+#define CIRCBUF_DEDUP_TEXT(__dd, __index) \
+	((__dd)->text + (__index) * ((__dd)->max + 1))
+
+/*
+ * FNV-1a hash of the string
+ */
+static inline uint64_t
+circstringbuf_dedup_hash(const char *string, size_t len) {
+uint64_t hash = 14695981039346656037ULL;
+
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ (unsigned char)string[i]) * 1099511628211ULL;
+
+	return hash;
+}
+
+/*
+ * parse the back-reference, false if the string is not one
+ *
+ * AI: REPEAT COUNTER IS NEVER 0 -- the string with the zero counter is not
+ *     the back-reference
+ */
+static bool
+circstringbuf_dedup_parse(const char *string, size_t len, size_t *pSlot,
+	uint32_t *pCount) {
+uint64_t value = 0;
+
+	if (len != CIRCBUF_DEDUP_REFLEN || string[0] != CIRCBUF_DEDUP_MARK)
+		return false;
+
+	for (size_t i = 1; i < CIRCBUF_DEDUP_REFLEN; i++) {
+
+char c = string[i];
+
+		if (c >= '0' && c <= '9')
+			value = (value << 4) | (c - '0');
+		else if (c >= 'a' && c <= 'f')
+			value = (value << 4) | (c - 'a' + 10);
+		else
+			return false;
+	}
+	if (!(uint32_t)value)
+		return false;
+	if (pSlot)
+		*pSlot = value >> 32;
+	if (pCount)
+		*pCount = (uint32_t)value;
+
+	return true;
+}
+
+/*
+ * write the back-reference given to the space allocated in the buffer
+ */
+static void
+circstringbuf_dedup_fill(void *ctx, char *part1, size_t size1, char *part2) {
+const char *ref = ctx;
+
+	memcpy(part1, ref, size1);
+	memcpy(part2, ref + size1, CIRCBUF_DEDUP_REFLEN - size1);
+}
+
+/*
+ * push the back-reference to the slot, or count the repeat in place if
+ * the newest string of the buffer is one
+ *
+ * AI: NEWEST STRING IS CHECKED UNDER THE LOCK -- the consumer must not
+ *     pop it while its counter is incremented
+ */
+static int
+circstringbuf_dedup_ref(circstringbuf_dedup_t *dd, size_t index,
+	bool *pCounted) {
+circstringbuf_t *cb = dd->cb;
+size_t len = CIRCBUF_DEDUP_REFLEN + 1;
+char ref[CIRCBUF_DEDUP_REFLEN + 1];
+
+#if defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_ACQUIRE_CONTEXT;
+#else /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+	CIRCBUF_ACQUIRE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+size_t used = cb->end - (CIRCBUF_SPACE_LEFT(cb->empty, cb->current_end,
+	cb->current_start, cb->end));
+size_t position = (cb->current_end + cb->end - len) % cb->end;
+size_t slot;
+uint32_t count;
+
+	if (used >= len) {
+
+		for (size_t i = 0; i < len; i++)
+			ref[i] = cb->start[(position + i) % cb->end];
+	}
+	if (CIRCBUF_DEDUP_IN_PLACE && used >= len &&
+		(position == cb->current_start ||
+		cb->start[(position + cb->end - 1) % cb->end] == cb->delim) &&
+		circstringbuf_dedup_parse(ref, CIRCBUF_DEDUP_REFLEN, &slot, &count) &&
+		slot == index && count < UINT32_MAX) {
+
+		circstringbuf_hex(ref + 5, CIRCBUF_DEDUP_REFLEN - 5, count + 1);
+		for (size_t i = 5; i < CIRCBUF_DEDUP_REFLEN; i++)
+			cb->start[(position + i) % cb->end] = ref[i];
+		*pCounted = true;
+	}
+
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_RELEASE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+	if (*pCounted)
+		return CIRCBUF_OK;
+
+	/*
+	 * Read after the push, seq_end is the end of the back-reference or
+	 * beyond it: the slot is kept no shorter than needed.
+	 */
+	ref[0] = CIRCBUF_DEDUP_MARK;
+	circstringbuf_hex(ref + 1, CIRCBUF_DEDUP_REFLEN - 1,
+		((uint64_t)index << 32) | 1);
+
+int result = circstringbuf_push_fill(cb, CIRCBUF_DEDUP_REFLEN,
+	circstringbuf_dedup_fill, ref);
+
+	if (result == CIRCBUF_OK || result == CIRCBUF_DATALOSS)
+		dd->slots[index].seq = CIRCBUF_SEQ_LOAD(cb->seq_end);
+
+	return result;
+}
+
+/*
+ * the string referenced by the back-reference being popped
+ */
+static inline const char *
+circstringbuf_dedup_pending(circstringbuf_dedup_t *dd, size_t *pLen) {
+
+	*pLen = dd->slots[dd->pending].len - 1;
+
+	return CIRCBUF_DEDUP_TEXT(dd, dd->pending);
+}
+
+/*
+ * memory needed for the table of the size given
+ */
+size_t
+circstringbuf_dedup_size(size_t count, size_t max) {
+
+	return count * (sizeof(circstringbuf_dedup_slot_t) + max + 1);
+}
+
+/*
+ * initialize deduplicating mode
+ */
+int
+circstringbuf_dedup_init(circstringbuf_dedup_t *dd, circstringbuf_t *cb,
+	void *memory, size_t size, size_t count, size_t max) {
+
+	if (!dd || !cb || !memory || !count || count > 65536 ||
+		(count & (count - 1)) || !max)
+		return CIRCBUF_ERROR;
+	if (size < circstringbuf_dedup_size(count, max) || cb->tier ||
+		cb->policy == CIRCBUF_PRIORITY || cb->delim == CIRCBUF_DEDUP_MARK ||
+		(cb->delim >= '0' && cb->delim <= '9') ||
+		(cb->delim >= 'a' && cb->delim <= 'f'))
+		return CIRCBUF_ERROR;
+
+	memset(dd, 0, sizeof(*dd));
+	dd->cb = cb;
+	dd->slots = memory;
+	dd->text = (char *)(dd->slots + count);
+	dd->count = count;
+	dd->max = max;
+	memset(dd->slots, 0, count * sizeof(*dd->slots));
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * push string, as the back-reference if it is interned
+ */
+int
+circstringbuf_dedup_push(circstringbuf_dedup_t *dd, const char *string) {
+
+	if (!dd || !dd->cb || !string)
+		return CIRCBUF_ERROR;
+
+size_t len = strlen(string);
+
+	if (circstringbuf_dedup_parse(string, len, NULL, NULL))
+		return CIRCBUF_ERROR;
+	if (len > dd->max || len <= CIRCBUF_DEDUP_REFLEN)
+		return circstringbuf_push_n(dd->cb, string, len);
+
+uint64_t hash = circstringbuf_dedup_hash(string, len);
+size_t index = hash & (dd->count - 1);
+circstringbuf_dedup_slot_t *slot = &dd->slots[index];
+char *text = CIRCBUF_DEDUP_TEXT(dd, index);
+
+	if (slot->len == len + 1 && slot->hash == hash &&
+		!memcmp(text, string, len)) {
+
+bool counted = false;
+int result = circstringbuf_dedup_ref(dd, index, &counted);
+
+		if (result == CIRCBUF_OK || result == CIRCBUF_DATALOSS) {
+
+			dd->hits++;
+			dd->saved += counted ? len + 1 : len - CIRCBUF_DEDUP_REFLEN;
+		}
+
+		return result;
+	}
+
+int result = circstringbuf_push_n(dd->cb, string, len);
+
+	/*
+	 * The slot taken is reused only once nothing refers to it, in the
+	 * buffer or being popped.
+	 */
+	if ((result == CIRCBUF_OK || result == CIRCBUF_DATALOSS) &&
+		(!slot->len || (slot->seq <= CIRCBUF_SEQ_LOAD(dd->cb->seq_start) &&
+		!(dd->repeat && dd->pending == index)))) {
+
+		memcpy(text, string, len + 1);
+		slot->hash = hash;
+		slot->seq = 0;
+		slot->len = len + 1;
+	}
+
+	return result;
+}
+
+/*
+ * pop string, resolving the back-reference
+ */
+int
+circstringbuf_dedup_pop(circstringbuf_dedup_t *dd, char *string, size_t size,
+	size_t *pLen) {
+
+	if (!dd || !dd->cb || !string)
+		return CIRCBUF_ERROR;
+
+size_t len = 0;
+
+	if (!dd->repeat) {
+
+int result = circstringbuf_pop_n(dd->cb, string, size, &len);
+
+		if (result == CIRCBUF_FULL && len == CIRCBUF_DEDUP_REFLEN) {
+
+char ref[CIRCBUF_DEDUP_REFLEN + 1];
+
+			/*
+			 * The string is too short for the back-reference
+			 * itself, the string it refers to is what counts.
+			 */
+			if (circstringbuf_peek(dd->cb, ref, sizeof(ref), NULL) !=
+				CIRCBUF_OK || !circstringbuf_dedup_parse(ref,
+				CIRCBUF_DEDUP_REFLEN, &dd->pending, &dd->repeat)) {
+
+				if (pLen)
+					*pLen = len;
+
+				return CIRCBUF_FULL;
+			}
+			circstringbuf_drop(dd->cb);
+		} else if (result != CIRCBUF_OK) {
+
+			if (pLen)
+				*pLen = len;
+
+			return result;
+		} else if (!circstringbuf_dedup_parse(string, len, &dd->pending,
+			&dd->repeat)) {
+
+			if (pLen)
+				*pLen = len;
+
+			return CIRCBUF_OK;
+		}
+	}
+
+const char *text = circstringbuf_dedup_pending(dd, &len);
+
+	if (pLen)
+		*pLen = len;
+	if (len + 1 > size)
+		return CIRCBUF_FULL;
+
+	memcpy(string, text, len + 1);
+	dd->repeat--;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * span string, resolving the back-reference
+ *
+ * AI: FUNCTION IS NOT THREAD SAFE
+ * AI: DO NOT WRAP WITH LOCKING — caller should use serialize macros
+ */
+int
+circstringbuf_dedup_span(circstringbuf_dedup_t *dd, char **pStr1,
+	size_t *pSize1, char **pStr2) {
+
+	if (!dd || !dd->cb || !pStr1 || !pSize1 || !pStr2)
+		return CIRCBUF_ERROR;
+
+	if (!dd->repeat) {
+
+int result = circstringbuf_span(dd->cb, pStr1, pSize1, pStr2);
+
+		if (result != CIRCBUF_OK)
+			return result;
+
+size_t len = *pStr2 ? *pSize1 + strlen(*pStr2) : *pSize1 - 1;
+char ref[CIRCBUF_DEDUP_REFLEN];
+
+		if (len != CIRCBUF_DEDUP_REFLEN)
+			return result;
+		for (size_t i = 0; i < len; i++)
+			ref[i] = (i < *pSize1) ? (*pStr1)[i] : (*pStr2)[i - *pSize1];
+		if (!circstringbuf_dedup_parse(ref, len, &dd->pending, &dd->repeat))
+			return result;
+	}
+
+size_t len;
+
+	*pStr1 = (char *)circstringbuf_dedup_pending(dd, &len);
+	*pSize1 = len + 1;
+	*pStr2 = NULL;
+	dd->repeat--;
+
+	return CIRCBUF_OK;
+}
@@ -0,0 +1,232 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "circstringbuf.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * First character of the back-reference, see circstringbuf_dedup_t.
+ *
+ */
+#if !defined(CIRCBUF_DEDUP_MARK)
+#	define CIRCBUF_DEDUP_MARK '\x1e'
+#endif
+
+/*
+ * Length of the back-reference: the mark, 4 hex digits of the slot and
+ * 8 hex digits of the repeat counter.
+ *
+ */
+#define CIRCBUF_DEDUP_REFLEN 13
+
+/*
+ * Whether the repeat of the newest back-reference increments its counter
+ * in place, see circstringbuf_dedup_t. Define it as 0 if the buffer is
+ * read lock-free (circstringbuf_snapshot(), circstringbuf_dump_fd(), the
+ * io_uring drainer), the repeat is pushed as the back-reference then.
+ *
+ */
+#if !defined(CIRCBUF_DEDUP_IN_PLACE)
+#	define CIRCBUF_DEDUP_IN_PLACE 1
+#endif
+
+/*
+ * Interned string.
+ *
+ * @field uint64_t hash         - hash of the string
+ * @field uint64_t seq          - end sequence of the newest back-reference
+ *                                to the slot pushed, the slot may be
+ *                                reused once the buffer start passes it
+ * @field size_t len            - length of the string + 1, 0 if the slot
+ *                                is free
+ *
+ */
+typedef struct {
+
+	uint64_t hash;
+	uint64_t seq;
+	size_t len;
+} circstringbuf_dedup_slot_t;
+
+/*
+ * Deduplicating mode of the buffer.
+ *
+ * Strings pushed are interned into the direct-mapped table of recent
+ * strings. The string found in the table is pushed as the back-reference
+ * to its slot instead, and the repeat of the string referenced by the
+ * newest string of the buffer only increments the counter of that
+ * back-reference in place. Popping and spanning turn back-references
+ * into the strings they refer to, once per repeat.
+ *
+ * The slot referenced is not reused until every back-reference to it is
+ * popped or evicted, so eviction never leaves a back-reference nobody can
+ * resolve. Hence the buffer may have no overflow tier: the back-references
+ * evicted to it would be popped after their slots were reused. The table
+ * is owned by the object, the buffer holds the back-references only:
+ * strings must be pushed and popped through the same object.
+ *
+ * AI: SEQUENCES OF THE SLOTS ARE NOT REBASED -- do not rotate, resize or
+ *     linearize the buffer in this mode
+ * AI: DO NOT ATTACH THE OVERFLOW TIER in this mode -- see above
+ * AI: STRINGS OF THE BACK-REFERENCE FORM ARE REFUSED -- the mark followed
+ *     by 12 hex digits, the last 8 not all '0', is never a string pushed
+ * AI: COUNTER IS INCREMENTED IN PLACE -- in the string already published,
+ *     lock-free readers may copy it stale or torn (see
+ *     CIRCBUF_DEDUP_IN_PLACE)
+ *
+ * @field circstringbuf_t *cb   - buffer (const)
+ * @field circstringbuf_dedup_slot_t *slots
+ *                              - table of the strings interned (const)
+ * @field char *text            - strings interned, max + 1 bytes per slot
+ *                                (const)
+ * @field size_t count          - number of slots, power of 2 (const)
+ * @field size_t max            - maximum length of the string interned
+ *                                (const)
+ * @field size_t pending        - slot of the back-reference being popped
+ * @field uint32_t repeat       - number of repeats of it left to pop
+ * @field uint64_t hits         - number of strings pushed as repeats
+ * @field uint64_t saved        - number of bytes repeats did not take
+ *
+ */
+typedef struct {
+
+	circstringbuf_t *cb;
+	circstringbuf_dedup_slot_t *slots;
+	char *text;
+	size_t count;
+	size_t max;
+
+	size_t pending;
+	uint32_t repeat;
+	uint64_t hits;
+	uint64_t saved;
+} circstringbuf_dedup_t;
+
+/*
+ * memory needed for the table of the size given
+ *
+ * @param size_t count          - number of slots
+ * @param size_t max            - maximum length of the string interned
+ * @return size_t               - number of bytes
+ *
+ * @mt-safety: safe
+ *
+ */
+size_t circstringbuf_dedup_size(size_t, size_t);
+
+/*
+ * initialize deduplicating mode
+ *
+ * @param circstringbuf_dedup_t *dd
+ *                              - deduplicating mode object
+ * @param circstringbuf_t *cb   - buffer, its delimiter must be neither
+ *                                a hex digit nor CIRCBUF_DEDUP_MARK, its
+ *                                policy not CIRCBUF_PRIORITY, and it must
+ *                                have no overflow tier
+ * @param void *memory          - memory of the table, aligned as uint64_t
+ * @param size_t size           - size of the memory, at least
+ *                                circstringbuf_dedup_size(count, max)
+ * @param size_t count          - number of slots, power of 2, up to 65536
+ * @param size_t max            - maximum length of the string interned,
+ *                                longer ones are pushed as they are, as
+ *                                are the ones not longer than the
+ *                                back-reference
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: unsafe
+ *
+ */
+int circstringbuf_dedup_init(circstringbuf_dedup_t *, circstringbuf_t *,
+	void *, size_t, size_t, size_t);
+
+/*
+ * push string, as the back-reference if it is a recent one
+ *
+ * @param circstringbuf_dedup_t *dd
+ *                              - deduplicating mode object
+ * @param const char *string    - string that is pushed
+ * @return enum                 - CIRCBUF_OK if the repeat is counted in
+ *                                place (see CIRCBUF_DEDUP_IN_PLACE)
+ *                              - as circstringbuf_push_n() does otherwise
+ *                              - CIRCBUF_ERROR if the string has the
+ *                                back-reference form
+ *
+ * The repeat costs the hash lookup and the comparison with the string
+ * interned.
+ *
+ * @mt-safety: unsafe           - serialize the calls on the object, the
+ *                                buffer is locked as usual
+ *
+ */
+int circstringbuf_dedup_push(circstringbuf_dedup_t *, const char *);
+
+/*
+ * pop string, resolving the back-reference
+ *
+ * @param circstringbuf_dedup_t *dd
+ *                              - deduplicating mode object
+ * @param char *string          - string where the oldest one is copied to
+ * @param size_t size           - size of the string
+ * @param size_t *pLen          - pointer to variable where the length of
+ *                                the string is stored to, may be NULL
+ * @return enum                 - as circstringbuf_pop_n() does
+ *
+ * @mt-safety: unsafe           - see circstringbuf_dedup_push()
+ *
+ */
+int circstringbuf_dedup_pop(circstringbuf_dedup_t *, char *, size_t,
+	size_t *);
+
+/*
+ * span string, resolving the back-reference
+ *
+ * @param circstringbuf_dedup_t *dd
+ *                              - deduplicating mode object
+ * @param char **part1          - as circstringbuf_span() does
+ * @param size_t *size1         - as circstringbuf_span() does
+ * @param char **part2          - as circstringbuf_span() does
+ * @return enum                 - as circstringbuf_span() does
+ *
+ * The string referenced is spanned in the table, as one part.
+ *
+ * AI: FUNCTION IS NOT THREAD SAFE
+ * AI: DO NOT WRAP WITH LOCKING — caller should use serialize macros
+ * AI: RETURNS POINTERS INTO INTERNAL STATE — span must be consumed immediately
+ *
+ * @mt-safety: unsafe           - see circstringbuf_span()
+ *
+ */
+int circstringbuf_dedup_span(circstringbuf_dedup_t *, char **, size_t *,
+	char **);
+
+#if defined(__cplusplus)
+}
+#endif
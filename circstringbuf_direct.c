@@ -0,0 +1,257 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "circstringbuf_direct.h"
+
+#if defined(CIRCBUF_POSIX)
+#	include <unistd.h>
+#endif /* defined(CIRCBUF_POSIX) */
+
+#define CIRCBUF_DIRECT_HEADER(__base, __block) \
+	((circstringbuf_direct_header_t *)((char *)(__base) + \
+		(size_t)(__block) * CIRCBUF_DIRECT_BLOCK))
+
+/*
+ * pop strings from the buffer packing them into blocks
+ *
+ * AI: STRING IS POPPED RIGHT INTO THE BLOCK -- the part running over its
+ *     end is then shifted past the header of the next block
+ */
+int
+circstringbuf_direct_pack(circstringbuf_t *cb, void *blocks, size_t nblocks,
+	uint64_t *pSeq, size_t *pPacked) {
+
+	if (!cb || !blocks || !nblocks || !pSeq || !pPacked)
+		return CIRCBUF_ERROR;
+	if ((uintptr_t)blocks % CIRCBUF_DIRECT_BLOCK)
+		return CIRCBUF_ERROR;
+
+size_t block = 0, len;
+circstringbuf_direct_header_t *header = CIRCBUF_DIRECT_HEADER(blocks, 0);
+int result;
+
+	memset(header, 0, sizeof(*header));
+	*pPacked = 0;
+
+	for (;;) {
+
+size_t left = CIRCBUF_DIRECT_PAYLOAD - header->used;
+char *position = (char *)(header + 1) + header->used;
+
+		/*
+		 * The string has to fit the blocks left.
+		 */
+		result = circstringbuf_pop_n(cb, position, left +
+			(nblocks - block - 1) * CIRCBUF_DIRECT_PAYLOAD, &len);
+		if (result != CIRCBUF_OK)
+			break;
+
+		for (len++; len > left; left = CIRCBUF_DIRECT_PAYLOAD) {
+
+			memmove(position + left + sizeof(*header), position + left,
+				len - left);
+			header->used = CIRCBUF_DIRECT_PAYLOAD;
+			header->flags |= CIRCBUF_DIRECT_CONT_NEXT;
+
+			header = CIRCBUF_DIRECT_HEADER(blocks, ++block);
+			memset(header, 0, sizeof(*header));
+			header->flags = CIRCBUF_DIRECT_CONT_PREV;
+			position = (char *)(header + 1);
+			len -= left;
+		}
+		header->used += len;
+
+		if (header->used == CIRCBUF_DIRECT_PAYLOAD) {
+
+			if (block + 1 == nblocks)
+				break;
+			header = CIRCBUF_DIRECT_HEADER(blocks, ++block);
+			memset(header, 0, sizeof(*header));
+		}
+	}
+
+	/*
+	 * Nothing is packed: the buffer is empty, or the string at its head
+	 * does not fit all the blocks and never will.
+	 */
+	if (block == 0 && header->used == 0)
+		return (result == CIRCBUF_OK) ? CIRCBUF_EMPTY : result;
+	if (header->used == 0)
+		block--;
+
+	for (size_t i = 0; i <= block; i++) {
+
+		header = CIRCBUF_DIRECT_HEADER(blocks, i);
+		header->magic = CIRCBUF_DIRECT_MAGIC;
+		header->seq = (*pSeq)++;
+	}
+	memset((char *)(header + 1) + header->used, 0,
+		CIRCBUF_DIRECT_PAYLOAD - header->used);
+	*pPacked = block + 1;
+
+	return CIRCBUF_OK;
+}
+
+#if defined(CIRCBUF_POSIX)
+/*
+ * write everything stored in the buffer as blocks to the file
+ */
+int
+circstringbuf_direct_drain(circstringbuf_t *cb, int fd, void *blocks,
+	size_t nblocks, uint64_t *pSeq) {
+int result = CIRCBUF_EMPTY;
+int packing;
+size_t packed;
+
+	if (fd < 0)
+		return CIRCBUF_ERROR;
+
+	while ((packing = circstringbuf_direct_pack(cb, blocks, nblocks, pSeq,
+		&packed)) == CIRCBUF_OK) {
+
+size_t size = packed * CIRCBUF_DIRECT_BLOCK;
+size_t written = 0;
+
+		/*
+		 * Direct I/O writes whole blocks or fails.
+		 */
+		while (written < size) {
+
+ssize_t chunk = write(fd, (char *)blocks + written, size - written);
+
+			if (chunk < 0 && errno == EINTR)
+				continue;
+			if (chunk <= 0 || chunk % CIRCBUF_DIRECT_BLOCK)
+				return CIRCBUF_ERROR;
+			written += chunk;
+		}
+		result = CIRCBUF_OK;
+	}
+
+	return (packing == CIRCBUF_EMPTY) ? result : packing;
+}
+#endif /* defined(CIRCBUF_POSIX) */
+
+/*
+ * start reading blocks
+ */
+int
+circstringbuf_direct_open(circstringbuf_direct_reader_t *reader,
+	const void *data, size_t size) {
+
+	if (!reader || (!data && size))
+		return CIRCBUF_ERROR;
+
+	reader->data = data;
+	reader->blocks = size / CIRCBUF_DIRECT_BLOCK;
+	reader->block = 0;
+	reader->offset = 0;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * read the next string
+ *
+ * AI: READER STATE IS ONLY UPDATED ON SUCCESS -- CIRCBUF_FULL leaves the
+ *     string to be read again into the bigger buffer
+ */
+int
+circstringbuf_direct_read(circstringbuf_direct_reader_t *reader,
+	char *string, size_t size, size_t *pLen) {
+
+	if (!reader || (!string && size))
+		return CIRCBUF_ERROR;
+
+size_t block = reader->block, offset = reader->offset, len = 0;
+bool skip = false;
+
+	for (;;) {
+
+		if (block >= reader->blocks)
+			return len ? CIRCBUF_ERROR : CIRCBUF_EMPTY;
+
+const circstringbuf_direct_header_t *header =
+	(const void *)(reader->data + block * CIRCBUF_DIRECT_BLOCK);
+const char *payload = (const char *)(header + 1);
+
+		if (header->magic != CIRCBUF_DIRECT_MAGIC ||
+			header->used > CIRCBUF_DIRECT_PAYLOAD)
+			return CIRCBUF_ERROR;
+
+		/*
+		 * Continuation of the string which beginning was not read.
+		 */
+		if (offset == 0 && len == 0 && !skip &&
+			(header->flags & CIRCBUF_DIRECT_CONT_PREV))
+			skip = true;
+
+		if (offset >= header->used) {
+
+			if (len)
+				return CIRCBUF_ERROR;
+			block++;
+			offset = 0;
+			continue;
+		}
+
+const char *terminator = memchr(payload + offset, '\0',
+	header->used - offset);
+size_t piece = (terminator ? terminator : payload + header->used) -
+	(payload + offset);
+
+		if (!skip && len + piece < size)
+			memcpy(string + len, payload + offset, piece);
+		if (!skip)
+			len += piece;
+
+		if (terminator) {
+
+			offset = terminator + 1 - payload;
+			if (skip) {
+
+				skip = false;
+				continue;
+			}
+			break;
+		}
+
+		if (!(header->flags & CIRCBUF_DIRECT_CONT_NEXT))
+			return CIRCBUF_ERROR;
+		block++;
+		offset = 0;
+	}
+
+	if (pLen)
+		*pLen = len;
+	if (len + 1 > size)
+		return CIRCBUF_FULL;
+
+	string[len] = '\0';
+	reader->block = block;
+	reader->offset = offset;
+
+	return CIRCBUF_OK;
+}
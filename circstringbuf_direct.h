@@ -0,0 +1,193 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "circstringbuf.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Block size of the direct I/O format, the staging memory, file offsets
+ * and write sizes are aligned to it.
+ *
+ */
+#if !defined(CIRCBUF_DIRECT_BLOCK)
+#	define CIRCBUF_DIRECT_BLOCK 4096
+#endif
+
+#define CIRCBUF_DIRECT_MAGIC 0x4B4C4243
+#define CIRCBUF_DIRECT_PAYLOAD \
+	(CIRCBUF_DIRECT_BLOCK - sizeof(circstringbuf_direct_header_t))
+
+/*
+ * Block flags.
+ *
+ * CIRCBUF_DIRECT_CONT_PREV     - payload starts with the rest of the string
+ *                                of the previous block
+ * CIRCBUF_DIRECT_CONT_NEXT     - the last string of the payload continues
+ *                                in the next block
+ *
+ */
+#define CIRCBUF_DIRECT_CONT_PREV 1
+#define CIRCBUF_DIRECT_CONT_NEXT 2
+
+/*
+ * Header of each block.
+ *
+ * Payload follows the header: strings, each '\0'-terminated, the first
+ * and the last ones possibly split with the neighbour blocks. The rest of
+ * the block past the payload is zero padding.
+ *
+ * @field uint32_t magic        - CIRCBUF_DIRECT_MAGIC
+ * @field uint16_t used         - payload size
+ * @field uint16_t flags        - CIRCBUF_DIRECT_* flags
+ * @field uint64_t seq          - block number in the stream
+ *
+ */
+typedef struct {
+
+	uint32_t magic;
+	uint16_t used;
+	uint16_t flags;
+	uint64_t seq;
+} circstringbuf_direct_header_t;
+
+/*
+ * Reader of the blocks written.
+ *
+ * @field const char *data      - blocks (const)
+ * @field size_t blocks         - number of blocks (const)
+ * @field size_t block          - current block
+ * @field size_t offset         - offset of the next string in its payload
+ *
+ */
+typedef struct {
+
+	const char *data;
+	size_t blocks;
+	size_t block;
+	size_t offset;
+} circstringbuf_direct_reader_t;
+
+/*
+ * pop strings from the buffer packing them into blocks
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param void *blocks          - staging memory, CIRCBUF_DIRECT_BLOCK
+ *                                aligned
+ * @param size_t nblocks        - number of blocks it has room for
+ * @param uint64_t *pSeq        - variable holding the number of the first
+ *                                block, advanced past the blocks packed
+ * @param size_t *pPacked       - pointer to variable where the number of
+ *                                blocks packed is stored to
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if buffer is empty
+ *                              - CIRCBUF_FULL if the string at the buffer
+ *                                head is longer than all the blocks hold,
+ *                                it is not popped then
+ *                              - CIRCBUF_ERROR on error
+ *
+ * Strings are popped while they fit, those not fitting the rest of the
+ * block continue in the next one. The last block is padded, so no string
+ * continues past the blocks packed. The string not fitting the blocks
+ * packed is left for the next call, which returns CIRCBUF_FULL if the
+ * string does not fit the empty blocks either.
+ *
+ * @mt-safety: safe             - as circstringbuf_pop() is
+ *
+ */
+int circstringbuf_direct_pack(circstringbuf_t *, void *, size_t,
+	uint64_t *, size_t *);
+
+#if defined(CIRCBUF_POSIX)
+/*
+ * write everything stored in the buffer as blocks to the file
+ *
+ * @param circstringbuf_t *cb   - static circbuffer object
+ * @param int fd                - file to write to, opened with O_DIRECT
+ *                                or not, positioned at a block boundary
+ * @param void *blocks          - staging memory, CIRCBUF_DIRECT_BLOCK
+ *                                aligned
+ * @param size_t nblocks        - number of blocks it has room for
+ * @param uint64_t *pSeq        - as circstringbuf_direct_pack() has
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if buffer is empty
+ *                              - CIRCBUF_FULL if the string at the buffer
+ *                                head is longer than all the blocks hold,
+ *                                the strings before it are written
+ *                              - CIRCBUF_ERROR on error, strings packed
+ *                                but not written are lost
+ *
+ * @mt-safety: safe             - as circstringbuf_pop() is
+ *
+ */
+int circstringbuf_direct_drain(circstringbuf_t *, int, void *, size_t,
+	uint64_t *);
+#endif /* defined(CIRCBUF_POSIX) */
+
+/*
+ * start reading blocks
+ *
+ * @param circstringbuf_direct_reader_t *reader
+ *                              - reader object
+ * @param const void *data      - blocks, e.g. the file mapped
+ * @param size_t size           - size of the data
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_direct_open(circstringbuf_direct_reader_t *, const void *,
+	size_t);
+
+/*
+ * read the next string
+ *
+ * @param circstringbuf_direct_reader_t *reader
+ *                              - reader object
+ * @param char *string          - string where the string is copied to
+ * @param size_t size           - size of the string
+ * @param size_t *pLen          - pointer to variable where the length of
+ *                                the string is stored to, may be NULL
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if there is no more
+ *                              - CIRCBUF_FULL if string is too small,
+ *                                nothing is read, *pLen is set
+ *                              - CIRCBUF_ERROR if data is corrupted
+ *
+ * The rest of the string the stream starts from the middle of is skipped.
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_direct_read(circstringbuf_direct_reader_t *, char *,
+	size_t, size_t *);
+
+#if defined(__cplusplus)
+}
+#endif
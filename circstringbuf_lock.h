@@ -0,0 +1,196 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+/*
+ * Lock backends of the buffer, selected by CIRCBUF_LOCK, see
+ * circstringbuf.h. Each buffer carries its lock in the lock field and
+ * CIRCBUF_ACQUIRE/CIRCBUF_RELEASE take it.
+ *
+ * CIRCBUF_LOCK_MUTEX           - pthread mutex, the thread sleeps in the
+ *                                kernel if the lock is taken
+ * CIRCBUF_LOCK_TICKET          - FIFO ticket spinlock, fair, yields the
+ *                                CPU after CIRCBUF_LOCK_SPINS spins: for
+ *                                short critical sections and no more
+ *                                threads than cores
+ * CIRCBUF_LOCK_ADAPTIVE        - spins CIRCBUF_LOCK_SPINS times, then
+ *                                sleeps on futex (yields where there is
+ *                                no futex)
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if !defined(CIRCBUF_LOCK_SPINS)
+#	define CIRCBUF_LOCK_SPINS 100
+#endif
+
+#if CIRCBUF_LOCK == CIRCBUF_LOCK_MUTEX
+#	include <pthread.h>
+
+typedef pthread_mutex_t circstringbuf_lock_t;
+
+static inline void
+circstringbuf_lock_init(circstringbuf_lock_t *lock) {
+
+	pthread_mutex_init(lock, NULL);
+}
+
+static inline void
+circstringbuf_lock_fini(circstringbuf_lock_t *lock) {
+
+	pthread_mutex_destroy(lock);
+}
+
+static inline void
+circstringbuf_lock_acquire(circstringbuf_lock_t *lock) {
+
+	pthread_mutex_lock(lock);
+}
+
+static inline void
+circstringbuf_lock_release(circstringbuf_lock_t *lock) {
+
+	pthread_mutex_unlock(lock);
+}
+
+#elif CIRCBUF_LOCK == CIRCBUF_LOCK_TICKET
+#	include <sched.h>
+
+/*
+ * @field uint32_t next         - next ticket to take
+ * @field uint32_t owner        - ticket holding the lock
+ */
+typedef struct {
+
+	uint32_t next;
+	uint32_t owner;
+} circstringbuf_lock_t;
+
+static inline void
+circstringbuf_lock_init(circstringbuf_lock_t *lock) {
+
+	lock->next = lock->owner = 0;
+}
+
+static inline void
+circstringbuf_lock_fini(circstringbuf_lock_t *lock) {
+
+	(void)lock;
+}
+
+static inline void
+circstringbuf_lock_acquire(circstringbuf_lock_t *lock) {
+uint32_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+
+	/*
+	 * The thread holding the ticket before ours may be preempted, so the
+	 * CPU is given away instead of spinning until the time slice ends.
+	 */
+	for (int spin = 0;
+		__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket; spin++) {
+
+		if (spin < CIRCBUF_LOCK_SPINS)
+			CIRCBUF_LOCK_PAUSE;
+		else
+			sched_yield();
+	}
+}
+
+static inline void
+circstringbuf_lock_release(circstringbuf_lock_t *lock) {
+
+	__atomic_store_n(&lock->owner, lock->owner + 1, __ATOMIC_RELEASE);
+}
+
+#elif CIRCBUF_LOCK == CIRCBUF_LOCK_ADAPTIVE
+#	if defined(__linux__)
+#		include <linux/futex.h>
+#		include <sys/syscall.h>
+#		include <unistd.h>
+#	else /* defined(__linux__) */
+#		include <sched.h>
+#	endif /* defined(__linux__) */
+
+/*
+ * @field uint32_t state        - 0 if free, 1 if taken, 2 if taken and
+ *                                somebody may sleep on it
+ */
+typedef struct {
+
+	uint32_t state;
+} circstringbuf_lock_t;
+
+static inline void
+circstringbuf_lock_init(circstringbuf_lock_t *lock) {
+
+	lock->state = 0;
+}
+
+static inline void
+circstringbuf_lock_fini(circstringbuf_lock_t *lock) {
+
+	(void)lock;
+}
+
+static inline void
+circstringbuf_lock_acquire(circstringbuf_lock_t *lock) {
+
+	for (int spin = 0; spin < CIRCBUF_LOCK_SPINS; spin++) {
+
+uint32_t state = 0;
+
+		if (__atomic_compare_exchange_n(&lock->state, &state, 1, false,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return;
+		CIRCBUF_LOCK_PAUSE;
+	}
+
+	/*
+	 * Taken as contended, so that the release wakes the next sleeper.
+	 */
+	while (__atomic_exchange_n(&lock->state, 2, __ATOMIC_ACQUIRE) != 0) {
+
+#if defined(__linux__)
+		syscall(SYS_futex, &lock->state, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+#else /* defined(__linux__) */
+		sched_yield();
+#endif /* defined(__linux__) */
+	}
+}
+
+static inline void
+circstringbuf_lock_release(circstringbuf_lock_t *lock) {
+
+	if (__atomic_exchange_n(&lock->state, 0, __ATOMIC_RELEASE) == 2) {
+
+#if defined(__linux__)
+		syscall(SYS_futex, &lock->state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#endif /* defined(__linux__) */
+	}
+}
+
+#else
+#	error "CIRCBUF_LOCK: unknown lock backend"
+#endif
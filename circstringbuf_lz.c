@@ -0,0 +1,532 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include "circstringbuf_lz.h"
+
+/*
+ * LZ4 block format: the sequence is the token (literal length and match
+ * length - 4 in nibbles, 15 continued by bytes added up while 255), the
+ * literals, 2-byte little-endian match offset and the match length
+ * continued. The last sequence has literals only, the last 5 bytes are
+ * always literals and no match starts in the last 12 bytes.
+ */
+#define CIRCBUF_LZ_MINMATCH 4
+#define CIRCBUF_LZ_LASTLITERALS 5
+#define CIRCBUF_LZ_MFLIMIT 12
+
+/*
+ * worst case size of the data compressed and byte-stuffed
+ */
+#define CIRCBUF_LZ_BOUND(__size) ((__size) + (__size) / 255 + 16)
+#define CIRCBUF_COBS_BOUND(__size) ((__size) + (__size) / 254 + 1)
+
+static inline uint32_t
+circstringbuf_lz_read32(const char *p) {
+uint32_t value;
+
+	memcpy(&value, p, sizeof(value));
+
+	return value;
+}
+
+static inline uint32_t
+circstringbuf_lz_hash(uint32_t value) {
+
+	return (value * 2654435761U) >> (32 - CIRCBUF_LZ_HASH_LOG);
+}
+
+/*
+ * write the length continued past the nibble
+ */
+static inline char *
+circstringbuf_lz_length(char *dst, size_t length) {
+
+	for (; length >= 255; length -= 255)
+		*dst++ = (char)255;
+	*dst++ = (char)length;
+
+	return dst;
+}
+
+/*
+ * write the sequence of the literals given, followed by the match unless
+ * match is 0
+ */
+static char *
+circstringbuf_lz_sequence(char *dst, const char *literals, size_t count,
+	size_t offset, size_t match) {
+char *token = dst++;
+
+	*token = (char)(((count < 15) ? count : 15) << 4);
+	if (count >= 15)
+		dst = circstringbuf_lz_length(dst, count - 15);
+	memcpy(dst, literals, count);
+	dst += count;
+	if (!match)
+		return dst;
+
+	*dst++ = (char)(offset & 0xFF);
+	*dst++ = (char)(offset >> 8);
+	match -= CIRCBUF_LZ_MINMATCH;
+	*token |= (char)((match < 15) ? match : 15);
+	if (match >= 15)
+		dst = circstringbuf_lz_length(dst, match - 15);
+
+	return dst;
+}
+
+/*
+ * compress the data, dst must hold CIRCBUF_LZ_BOUND(size) bytes
+ *
+ * AI: GREEDY, ONE HASH PROBE PER POSITION -- speed over the ratio, as the
+ *     block is sealed on the push path
+ */
+static size_t
+circstringbuf_lz_compress(const char *src, size_t size, char *dst) {
+uint32_t table[1 << CIRCBUF_LZ_HASH_LOG];
+size_t ip = 0, anchor = 0;
+char *op = dst;
+
+	/*
+	 * Positions are stored + 1, so 0 is the empty slot.
+	 */
+	memset(table, 0, sizeof(table));
+	while (size >= CIRCBUF_LZ_MFLIMIT && ip + CIRCBUF_LZ_MFLIMIT <= size) {
+
+uint32_t value = circstringbuf_lz_read32(src + ip);
+uint32_t h = circstringbuf_lz_hash(value);
+size_t ref = table[h];
+
+		table[h] = (uint32_t)ip + 1;
+		if (!ref || ip + 1 - ref > 65535 ||
+			circstringbuf_lz_read32(src + ref - 1) != value) {
+
+			ip++;
+			continue;
+		}
+		ref--;
+
+size_t match = CIRCBUF_LZ_MINMATCH;
+
+		while (ip + match < size - CIRCBUF_LZ_LASTLITERALS &&
+			src[ref + match] == src[ip + match])
+			match++;
+
+		op = circstringbuf_lz_sequence(op, src + anchor, ip - anchor,
+			ip - ref, match);
+		ip += match;
+		anchor = ip;
+	}
+
+	op = circstringbuf_lz_sequence(op, src + anchor, size - anchor, 0, 0);
+
+	return op - dst;
+}
+
+/*
+ * read the length continued past the nibble, false if the data ends
+ */
+static inline bool
+circstringbuf_lz_continued(const unsigned char *src, size_t size,
+	size_t *pos, size_t *length) {
+unsigned char b;
+
+	do {
+
+		if (*pos >= size)
+			return false;
+		b = src[(*pos)++];
+		*length += b;
+	} while (b == 255);
+
+	return true;
+}
+
+/*
+ * decompress the data to dst of capacity given, -1 if it is corrupt
+ *
+ * AI: EVERY READ AND WRITE IS BOUNDS-CHECKED -- blocks come from the
+ *     buffer, which may be shared with other processes
+ */
+static long
+circstringbuf_lz_decompress(const char *data, size_t size, char *dst,
+	size_t capacity) {
+const unsigned char *src = (const unsigned char *)data;
+size_t ip = 0, op = 0;
+
+	while (ip < size) {
+
+unsigned token = src[ip++];
+size_t count = token >> 4;
+
+		if (count == 15 && !circstringbuf_lz_continued(src, size, &ip, &count))
+			return -1;
+		if (count > size - ip || count > capacity - op)
+			return -1;
+		memcpy(dst + op, src + ip, count);
+		ip += count;
+		op += count;
+		if (ip == size)
+			break;
+
+		if (size - ip < 2)
+			return -1;
+
+size_t offset = src[ip] | (src[ip + 1] << 8);
+size_t match = token & 15;
+
+		ip += 2;
+		if (match == 15 && !circstringbuf_lz_continued(src, size, &ip, &match))
+			return -1;
+		match += CIRCBUF_LZ_MINMATCH;
+		if (!offset || offset > op || match > capacity - op)
+			return -1;
+
+		/*
+		 * The match may overlap the output, so it is copied bytewise.
+		 */
+		for (size_t i = 0; i < match; i++, op++)
+			dst[op] = dst[op - offset];
+	}
+
+	return (long)op;
+}
+
+/*
+ * byte-stuff the data, so that no byte of it is '\0', and turn it into
+ * no byte being the delimiter, dst must hold CIRCBUF_COBS_BOUND(size)
+ * bytes
+ */
+static size_t
+circstringbuf_cobs_encode(const char *src, size_t size, char *dst,
+	char delim) {
+size_t code = 0, op = 1;
+unsigned char run = 1;
+
+	for (size_t i = 0; i < size; i++) {
+
+		if (src[i]) {
+
+			dst[op++] = src[i];
+			if (++run < 0xFF)
+				continue;
+		}
+		dst[code] = (char)run;
+		code = op++;
+		run = 1;
+	}
+	dst[code] = (char)run;
+
+	for (size_t i = 0; i < op; i++)
+		dst[i] ^= delim;
+
+	return op;
+}
+
+/*
+ * undo circstringbuf_cobs_encode() in place, -1 if the data is corrupt
+ */
+static long
+circstringbuf_cobs_decode(char *data, size_t size, char delim) {
+size_t ip = 0, op = 0;
+
+	for (size_t i = 0; i < size; i++)
+		data[i] ^= delim;
+
+	while (ip < size) {
+
+unsigned char run = (unsigned char)data[ip++];
+
+		if (!run || (size_t)run - 1 > size - ip)
+			return -1;
+		memmove(data + op, data + ip, run - 1);
+		ip += run - 1;
+		op += run - 1;
+		if (run < 0xFF && ip < size)
+			data[op++] = '\0';
+	}
+
+	return (long)op;
+}
+
+/*
+ * decode the block as stored to dst of the block size
+ */
+static long
+circstringbuf_lz_unpack(circstringbuf_lz_t *lz, char *block, size_t size,
+	char *dst) {
+long len = circstringbuf_cobs_decode(block, size, lz->cb->delim);
+
+	if (len < 0)
+		return -1;
+
+	return circstringbuf_lz_decompress(block, len, dst, lz->block);
+}
+
+/*
+ * call the function for each string of the region, '\0'-terminating
+ * them for the call
+ */
+static int
+circstringbuf_lz_visit(circstringbuf_lz_t *lz, char *data, size_t size,
+	int (*fn)(const char *, size_t, void *), void *ctx) {
+char delim = lz->cb->delim;
+
+	for (size_t pos = 0; pos < size; ) {
+
+char *end = memchr(data + pos, delim, size - pos);
+
+		if (!end)
+			return CIRCBUF_ERROR;
+
+int stop;
+
+		*end = '\0';
+		stop = fn(data + pos, end - (data + pos), ctx);
+		*end = delim;
+		if (stop)
+			return CIRCBUF_EMPTY;
+		pos = end + 1 - data;
+	}
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * memory needed for the compressed mode of the block size given
+ */
+size_t
+circstringbuf_lz_size(size_t block) {
+
+	return 2 * block + CIRCBUF_LZ_BOUND(block) +
+		CIRCBUF_COBS_BOUND(CIRCBUF_LZ_BOUND(block)) + 1;
+}
+
+/*
+ * initialize compressed mode
+ */
+int
+circstringbuf_lz_init(circstringbuf_lz_t *lz, circstringbuf_t *cb,
+	void *memory, size_t size, size_t block) {
+
+	if (!lz || !cb || !memory || block < 2 || block > UINT32_MAX)
+		return CIRCBUF_ERROR;
+	if (size < circstringbuf_lz_size(block) ||
+		CIRCBUF_COBS_BOUND(CIRCBUF_LZ_BOUND(block)) >= cb->end)
+		return CIRCBUF_ERROR;
+
+	memset(lz, 0, sizeof(*lz));
+	lz->cb = cb;
+	lz->block = block;
+	lz->raw = memory;
+	lz->out = lz->raw + block;
+	lz->lz = lz->out + block;
+	lz->cobs = lz->lz + CIRCBUF_LZ_BOUND(block);
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * compress the strings staged and push them as one block
+ */
+int
+circstringbuf_lz_seal(circstringbuf_lz_t *lz) {
+
+	if (!lz || !lz->cb)
+		return CIRCBUF_ERROR;
+	if (!lz->used)
+		return CIRCBUF_OK;
+
+size_t len = circstringbuf_lz_compress(lz->raw, lz->used, lz->lz);
+
+	len = circstringbuf_cobs_encode(lz->lz, len, lz->cobs, lz->cb->delim);
+
+int result = circstringbuf_push_n(lz->cb, lz->cobs, len);
+
+	if (result == CIRCBUF_FULL || result == CIRCBUF_ERROR)
+		lz->lost += lz->count;
+
+	lz->in += lz->used;
+	lz->stored += len + 1;
+	lz->used = 0;
+	lz->count = 0;
+
+	return result;
+}
+
+/*
+ * stage string to be sealed into the block
+ */
+int
+circstringbuf_lz_push(circstringbuf_lz_t *lz, const char *string) {
+
+	if (!lz || !lz->cb || !string)
+		return CIRCBUF_ERROR;
+
+size_t len = strlen(string) + 1;
+int result = CIRCBUF_OK;
+
+	if (len > lz->block)
+		return CIRCBUF_ERROR;
+	if (lz->used + len > lz->block)
+		result = circstringbuf_lz_seal(lz);
+
+	memcpy(lz->raw + lz->used, string, len - 1);
+	lz->raw[lz->used + len - 1] = lz->cb->delim;
+	lz->used += len;
+	lz->count++;
+
+	return result;
+}
+
+/*
+ * pop the oldest string, decompressing the next block if needed
+ */
+int
+circstringbuf_lz_pop(circstringbuf_lz_t *lz, char *string, size_t size,
+	size_t *pLen) {
+
+	if (!lz || !lz->cb || !string)
+		return CIRCBUF_ERROR;
+
+	if (lz->out_pos == lz->out_used) {
+
+size_t len;
+int result = circstringbuf_pop_n(lz->cb, lz->cobs,
+	CIRCBUF_COBS_BOUND(CIRCBUF_LZ_BOUND(lz->block)) + 1, &len);
+
+		lz->out_pos = lz->out_used = 0;
+		if (result == CIRCBUF_EMPTY) {
+
+			if (!lz->used)
+				return CIRCBUF_EMPTY;
+
+			/*
+			 * Nothing older is stored, so the strings staged go
+			 * next as they are.
+			 */
+			memcpy(lz->out, lz->raw, lz->used);
+			lz->out_used = lz->used;
+			lz->used = 0;
+			lz->count = 0;
+		} else {
+
+			/*
+			 * The block too large for the scratch area is not
+			 * ours, it is dropped as the corrupt one is.
+			 */
+			if (result == CIRCBUF_FULL)
+				circstringbuf_drop(lz->cb);
+			if (result != CIRCBUF_OK)
+				return CIRCBUF_ERROR;
+
+long unpacked = circstringbuf_lz_unpack(lz, lz->cobs, len, lz->out);
+
+			if (unpacked < 0)
+				return CIRCBUF_ERROR;
+			lz->out_used = unpacked;
+		}
+	}
+
+char *start = lz->out + lz->out_pos;
+char *end = memchr(start, lz->cb->delim, lz->out_used - lz->out_pos);
+
+	if (!end) {
+
+		lz->out_pos = lz->out_used;
+
+		return CIRCBUF_ERROR;
+	}
+
+size_t len = end - start;
+
+	if (pLen)
+		*pLen = len;
+	if (len + 1 > size)
+		return CIRCBUF_FULL;
+
+	memcpy(string, start, len);
+	string[len] = '\0';
+	lz->out_pos += len + 1;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * call the function for each string without popping them
+ */
+int
+circstringbuf_lz_iterate(circstringbuf_lz_t *lz,
+	int (*fn)(const char *, size_t, void *), void *ctx) {
+
+	if (!lz || !lz->cb || !fn)
+		return CIRCBUF_ERROR;
+
+circstringbuf_segment_t seg1, seg2;
+size_t count = 0;
+int result = circstringbuf_peek_bulk(lz->cb, SIZE_MAX, SIZE_MAX, &seg1, &seg2,
+	&count);
+
+	if (result != CIRCBUF_OK && result != CIRCBUF_EMPTY)
+		return CIRCBUF_ERROR;
+	if (!count && lz->out_pos == lz->out_used && !lz->used)
+		return CIRCBUF_EMPTY;
+
+	result = circstringbuf_lz_visit(lz, lz->out + lz->out_pos,
+		lz->out_used - lz->out_pos, fn, ctx);
+
+	/*
+	 * Each block is copied out of the buffer, as it may wrap, decoded in
+	 * place and decompressed to the compression scratch area.
+	 */
+size_t pos = 0, limit = CIRCBUF_COBS_BOUND(CIRCBUF_LZ_BOUND(lz->block));
+
+	for (size_t i = 0; i < count && result == CIRCBUF_OK; i++) {
+
+size_t len = 0;
+char c;
+
+		do {
+
+			c = (pos < seg1.size) ? seg1.data[pos] :
+				seg2.data[pos - seg1.size];
+			pos++;
+			if (c != lz->cb->delim && len < limit)
+				lz->cobs[len] = c;
+			len++;
+		} while (c != lz->cb->delim);
+
+long unpacked = (len - 1 <= limit) ?
+	circstringbuf_lz_unpack(lz, lz->cobs, len - 1, lz->lz) : -1;
+
+		if (unpacked < 0)
+			return CIRCBUF_ERROR;
+		result = circstringbuf_lz_visit(lz, lz->lz, unpacked, fn, ctx);
+	}
+
+	if (result == CIRCBUF_OK)
+		result = circstringbuf_lz_visit(lz, lz->raw, lz->used, fn, ctx);
+
+	return (result == CIRCBUF_EMPTY) ? CIRCBUF_OK : result;
+}
@@ -0,0 +1,223 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "circstringbuf.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Size of the hash table of the compressor, log2 of the number of
+ * entries (4 bytes each, on the stack of the caller of
+ * circstringbuf_lz_seal()).
+ *
+ */
+#if !defined(CIRCBUF_LZ_HASH_LOG)
+#	define CIRCBUF_LZ_HASH_LOG 12
+#endif
+
+/*
+ * Compressed mode of the buffer.
+ *
+ * Strings are appended to the raw staging area of the block size and,
+ * once it is full, the block is sealed: compressed in LZ4 block format,
+ * byte-stuffed (COBS) not to contain the delimiter of the buffer and
+ * pushed to the buffer as one string. Eviction drops whole blocks then,
+ * and popping decompresses the oldest block to the read area to take its
+ * strings one by one.
+ *
+ * Repetitive text stores several times more history in the same buffer,
+ * and the blocks dumped or drained are as small. The strings of the
+ * block sealed last are lost together if the buffer evicts it.
+ *
+ * @field circstringbuf_t *cb   - buffer the blocks are pushed to (const)
+ * @field size_t block          - size of the block (const)
+ * @field char *raw             - staging area, block bytes (const)
+ * @field char *out             - read area, block bytes (const)
+ * @field char *lz              - compressed block (const)
+ * @field char *cobs            - block as stored, '\0'-terminated (const)
+ * @field size_t used           - number of bytes staged
+ * @field size_t count          - number of strings staged
+ * @field size_t out_used       - number of bytes in the read area
+ * @field size_t out_pos        - position of the next string to pop in
+ *                                the read area
+ * @field uint64_t in           - number of bytes sealed
+ * @field uint64_t stored       - number of bytes of the blocks sealed, as
+ *                                stored
+ * @field uint64_t lost         - number of strings sealed the buffer
+ *                                refused
+ *
+ */
+typedef struct {
+
+	circstringbuf_t *cb;
+	size_t block;
+	char *raw;
+	char *out;
+	char *lz;
+	char *cobs;
+
+	size_t used;
+	size_t count;
+	size_t out_used;
+	size_t out_pos;
+	uint64_t in;
+	uint64_t stored;
+	uint64_t lost;
+} circstringbuf_lz_t;
+
+/*
+ * memory needed for the compressed mode of the block size given
+ *
+ * @param size_t block          - size of the block
+ * @return size_t               - number of bytes
+ *
+ * @mt-safety: safe
+ *
+ */
+size_t circstringbuf_lz_size(size_t);
+
+/*
+ * initialize compressed mode
+ *
+ * @param circstringbuf_lz_t *lz
+ *                              - compressed mode object
+ * @param circstringbuf_t *cb   - buffer to push the blocks to, the block
+ *                                stored must fit into it
+ * @param void *memory          - memory of the staging, read and scratch
+ *                                areas
+ * @param size_t size           - size of the memory, at least
+ *                                circstringbuf_lz_size(block)
+ * @param size_t block          - size of the block, 4 KiB..64 KiB gives
+ *                                the good ratio
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: unsafe
+ *
+ */
+int circstringbuf_lz_init(circstringbuf_lz_t *, circstringbuf_t *, void *,
+	size_t, size_t);
+
+/*
+ * stage string to be sealed into the block
+ *
+ * @param circstringbuf_lz_t *lz
+ *                              - compressed mode object
+ * @param const char *string    - string that is copied, with no
+ *                                delimiter of the buffer in it
+ * @return enum                 - CIRCBUF_OK if the string is staged and
+ *                                no block was sealed
+ *                              - as circstringbuf_lz_seal() does
+ *                                otherwise, for the block sealed
+ *                              - CIRCBUF_ERROR if the string with its
+ *                                delimiter is longer than the block
+ *
+ * @mt-safety: unsafe           - serialize the calls on the object, the
+ *                                buffer is locked as usual
+ *
+ */
+int circstringbuf_lz_push(circstringbuf_lz_t *, const char *);
+
+/*
+ * compress the strings staged and push them to the buffer as one block
+ *
+ * @param circstringbuf_lz_t *lz
+ *                              - compressed mode object
+ * @return enum                 - CIRCBUF_OK if nothing is staged
+ *                              - as circstringbuf_push_n() does otherwise
+ *
+ * Strings the buffer refuses (CIRCBUF_FULL, CIRCBUF_ERROR) are counted as
+ * lost and dropped. Call it to make the strings staged durable, e.g.
+ * before the buffer is dumped.
+ *
+ * @mt-safety: unsafe           - see circstringbuf_lz_push()
+ *
+ */
+int circstringbuf_lz_seal(circstringbuf_lz_t *);
+
+/*
+ * pop the oldest string
+ *
+ * @param circstringbuf_lz_t *lz
+ *                              - compressed mode object
+ * @param char *string          - string where the oldest one is copied to
+ * @param size_t size           - size of the string
+ * @param size_t *pLen          - pointer to variable where the length of
+ *                                the string is stored to, may be NULL
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if nothing is stored or
+ *                                staged
+ *                              - CIRCBUF_FULL if the string with its
+ *                                '\0' does not fit into size, it is not
+ *                                popped then and *pLen tells how long
+ *                                it is
+ *                              - CIRCBUF_ERROR on error, or if the block
+ *                                popped is corrupt, it is dropped then
+ *
+ * The oldest block is decompressed when the read area is used up. Once
+ * the buffer is empty, the strings staged are popped without sealing.
+ *
+ * @mt-safety: unsafe           - see circstringbuf_lz_push()
+ *
+ */
+int circstringbuf_lz_pop(circstringbuf_lz_t *, char *, size_t, size_t *);
+
+/*
+ * call the function for each string, oldest first, without popping them
+ *
+ * @param circstringbuf_lz_t *lz
+ *                              - compressed mode object
+ * @param fn                    - function called with the string, its
+ *                                length and ctx, returning non-zero to
+ *                                stop
+ * @param void *ctx             - context of the function
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if nothing is stored or
+ *                                staged
+ *                              - CIRCBUF_ERROR on error, as
+ *                                circstringbuf_peek_bulk() does, or if
+ *                                a block is corrupt
+ *
+ * Strings of the read area, of the blocks stored and the ones staged are
+ * visited in turn. The strings are '\0'-terminated for the function, and
+ * the pointers are valid for the call only.
+ *
+ * AI: READS BLOCKS IN PLACE — do not push to the buffer meanwhile, unless
+ *     the policy is CIRCBUF_DROP_NEWEST or CIRCBUF_BLOCK
+ *
+ * @mt-safety: unsafe           - see circstringbuf_lz_push()
+ *
+ */
+int circstringbuf_lz_iterate(circstringbuf_lz_t *,
+	int (*)(const char *, size_t, void *), void *);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,457 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include "circstringbuf_pool.h"
+
+#define CIRCBUF_PAGE(__pool, __index) \
+	((circstringbuf_page_t *)((__pool)->arena + (size_t)(__index) * (__pool)->page_size))
+#define CIRCBUF_PAGE_PAYLOAD(__pool) \
+	((__pool)->page_size - sizeof(circstringbuf_page_t))
+
+/*
+ * How many buffers busy with their own operations eviction tries to skip
+ * before it gives up.
+ */
+#define CIRCBUF_EVICT_ATTEMPTS 8
+
+static inline void
+circstringbuf_spin_lock(bool *lock) {
+
+	while (__atomic_test_and_set(lock, __ATOMIC_ACQUIRE)) {
+
+		while (__atomic_load_n(lock, __ATOMIC_RELAXED))
+			CIRCBUF_LOCK_PAUSE;
+	}
+}
+
+static inline bool
+circstringbuf_spin_trylock(bool *lock) {
+
+	return !__atomic_test_and_set(lock, __ATOMIC_ACQUIRE);
+}
+
+static inline void
+circstringbuf_spin_unlock(bool *lock) {
+
+	__atomic_clear(lock, __ATOMIC_RELEASE);
+}
+
+/*
+ * initialize page pool
+ */
+int
+circstringbuf_pool_init(circstringbuf_pool_t *pool, void *arena,
+	size_t arena_size, size_t page_size, size_t budget) {
+
+	if (!pool || !arena)
+		return CIRCBUF_ERROR;
+	if (page_size % sizeof(uint64_t) || page_size <= sizeof(circstringbuf_page_t)
+		|| page_size - sizeof(circstringbuf_page_t) > UINT32_MAX)
+		return CIRCBUF_ERROR;
+	if (arena_size / page_size == 0 || arena_size / page_size >= UINT32_MAX)
+		return CIRCBUF_ERROR;
+
+	pool->arena = arena;
+	pool->page_size = page_size;
+	pool->pages = arena_size / page_size;
+	pool->budget = (budget && budget / page_size < pool->pages) ?
+		budget / page_size : pool->pages;
+	if (!pool->budget)
+		return CIRCBUF_ERROR;
+
+	/* Free list links pages in the arena order. */
+	for (uint32_t index = 0; index < pool->pages; index++)
+		CIRCBUF_PAGE(pool, index)->free_next =
+			(index + 1 < pool->pages) ? index + 2 : 0;
+	pool->free_top = 1;
+	pool->in_use = 0;
+	pool->stamp = 0;
+	pool->lock = false;
+	pool->buffers = pool->last = NULL;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * take a page from the pool
+ *
+ * AI: LOCK-FREE -- budget is reserved by CAS first, then the page is popped
+ *     off the Treiber stack, ABA is prevented by the tag in free_top
+ * AI: RETURNS NULL if the budget or the pool is exhausted
+ */
+static circstringbuf_page_t *
+circstringbuf_pool_get(circstringbuf_pool_t *pool) {
+uint32_t used = __atomic_load_n(&pool->in_use, __ATOMIC_RELAXED);
+
+	do {
+
+		if (used >= pool->budget)
+			return NULL;
+	} while (!__atomic_compare_exchange_n(&pool->in_use, &used, used + 1,
+		true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+uint64_t top = __atomic_load_n(&pool->free_top, __ATOMIC_ACQUIRE);
+circstringbuf_page_t *page;
+
+	do {
+
+		if ((uint32_t)top == 0) {
+
+			__atomic_sub_fetch(&pool->in_use, 1, __ATOMIC_RELAXED);
+
+			return NULL;
+		}
+		page = CIRCBUF_PAGE(pool, (uint32_t)top - 1);
+	} while (!__atomic_compare_exchange_n(&pool->free_top, &top,
+		(((top >> 32) + 1) << 32) |
+			__atomic_load_n(&page->free_next, __ATOMIC_RELAXED),
+		true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+	page->next = NULL;
+	page->stamp = __atomic_add_fetch(&pool->stamp, 1, __ATOMIC_RELAXED);
+	page->head = page->tail = page->count = 0;
+
+	return page;
+}
+
+/*
+ * return a page to the pool
+ */
+static void
+circstringbuf_pool_put(circstringbuf_pool_t *pool, circstringbuf_page_t *page) {
+uint32_t index = ((char *)page - pool->arena) / pool->page_size + 1;
+uint64_t top = __atomic_load_n(&pool->free_top, __ATOMIC_RELAXED);
+
+	do {
+
+		__atomic_store_n(&page->free_next, (uint32_t)top, __ATOMIC_RELAXED);
+	} while (!__atomic_compare_exchange_n(&pool->free_top, &top,
+		(((top >> 32) + 1) << 32) | index,
+		true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	__atomic_sub_fetch(&pool->in_use, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * move the buffer to its place in the pool list after its oldest page
+ * has changed, unlink it if it has no page left
+ *
+ * AI: CALLER HOLDS THE BUFFER LOCK AND THE POOL ONE
+ * AI: STAMPS ONLY GROW -- the buffer is moved towards the list end past
+ *     the buffers whose oldest pages are between its old and new ones,
+ *     the buffer getting its first page is placed from the list end
+ */
+static void
+circstringbuf_pool_requeue(circstringbuf_pool_t *pool, circstringbuf_seg_t *seg) {
+circstringbuf_seg_t *after = pool->last;
+
+	if (seg->prev || pool->buffers == seg) {
+
+		after = seg->prev;
+		*(seg->prev ? &seg->prev->next : &pool->buffers) = seg->next;
+		*(seg->next ? &seg->next->prev : &pool->last) = seg->prev;
+		seg->prev = seg->next = NULL;
+	}
+
+	seg->oldest = seg->head ? seg->head->stamp : UINT64_MAX;
+	if (!seg->head)
+		return;
+
+	while (after && after->oldest > seg->oldest)
+		after = after->prev;
+	for (circstringbuf_seg_t *next = after ? after->next : pool->buffers;
+		next && next->oldest < seg->oldest; next = next->next)
+		after = next;
+
+	seg->prev = after;
+	seg->next = after ? after->next : pool->buffers;
+	*(seg->next ? &seg->next->prev : &pool->last) = seg;
+	*(after ? &after->next : &pool->buffers) = seg;
+}
+
+/*
+ * unlink the oldest page of the buffer and return it to the pool
+ *
+ * AI: CALLER HOLDS THE BUFFER LOCK AND THE POOL ONE
+ */
+static void
+circstringbuf_seg_shift(circstringbuf_seg_t *seg) {
+circstringbuf_page_t *page = seg->head;
+
+	seg->head = page->next;
+	if (!seg->head)
+		seg->tail = NULL;
+	circstringbuf_pool_requeue(seg->pool, seg);
+
+	circstringbuf_pool_put(seg->pool, page);
+}
+
+/*
+ * evict the oldest page of all the buffers of the pool
+ *
+ * AI: CALLER HOLDS THE LOCK OF "self" -- other buffers are only try-locked,
+ *     so buffers evicting each other never deadlock
+ * AI: THE FIRST BUFFER OF THE POOL LIST HOLDS THE OLDEST PAGE -- the next
+ *     ones are only tried while the older ones are busy
+ */
+static bool
+circstringbuf_pool_evict(circstringbuf_pool_t *pool, circstringbuf_seg_t *self) {
+bool evicted = false;
+int attempt = 0;
+
+	circstringbuf_spin_lock(&pool->lock);
+
+	for (circstringbuf_seg_t *victim = pool->buffers;
+		victim && attempt < CIRCBUF_EVICT_ATTEMPTS;
+		victim = victim->next, attempt++) {
+
+		if (victim == self || circstringbuf_spin_trylock(&victim->lock)) {
+
+			victim->dropped += victim->head->count;
+			circstringbuf_seg_shift(victim);
+			if (victim != self)
+				circstringbuf_spin_unlock(&victim->lock);
+			evicted = true;
+			break;
+		}
+	}
+
+	circstringbuf_spin_unlock(&pool->lock);
+
+	return evicted;
+}
+
+/*
+ * initialize segmented buffer drawing pages from the pool
+ */
+int
+circstringbuf_seg_init(circstringbuf_seg_t *seg, circstringbuf_pool_t *pool) {
+
+	if (!seg || !pool)
+		return CIRCBUF_ERROR;
+
+	seg->pool = pool;
+	seg->head = seg->tail = NULL;
+	seg->oldest = UINT64_MAX;
+	seg->dropped = 0;
+	seg->lock = false;
+	seg->prev = seg->next = NULL;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * return all the pages of segmented buffer to the pool and detach it
+ */
+int
+circstringbuf_seg_release(circstringbuf_seg_t *seg) {
+
+	if (!seg || !seg->pool)
+		return CIRCBUF_ERROR;
+
+	/*
+	 * The buffer leaves the pool list with its last page.
+	 */
+	circstringbuf_spin_lock(&seg->lock);
+	circstringbuf_spin_lock(&seg->pool->lock);
+
+	while (seg->head)
+		circstringbuf_seg_shift(seg);
+
+	circstringbuf_spin_unlock(&seg->pool->lock);
+	circstringbuf_spin_unlock(&seg->lock);
+	seg->pool = NULL;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * push string to segmented buffer
+ */
+int
+circstringbuf_seg_push(circstringbuf_seg_t *seg, const char *string) {
+
+	if (!seg || !seg->pool || !string)
+		return CIRCBUF_ERROR;
+
+size_t len = strlen(string) + 1;
+int result = CIRCBUF_OK;
+
+	if (len > CIRCBUF_PAGE_PAYLOAD(seg->pool))
+		return CIRCBUF_ERROR;
+
+	circstringbuf_spin_lock(&seg->lock);
+
+	/*
+	 * Strings never span pages: if the newest page has not enough room
+	 * left, the buffer grows by another page.
+	 */
+	if (!seg->tail || CIRCBUF_PAGE_PAYLOAD(seg->pool) - seg->tail->tail < len) {
+
+circstringbuf_page_t *page;
+
+		while (!(page = circstringbuf_pool_get(seg->pool))) {
+
+			if (!circstringbuf_pool_evict(seg->pool, seg)) {
+
+				circstringbuf_spin_unlock(&seg->lock);
+
+				return CIRCBUF_ERROR;
+			}
+			result = CIRCBUF_DATALOSS;
+		}
+
+		if (seg->tail) {
+
+			seg->tail->next = page;
+		} else {
+
+			seg->head = page;
+			circstringbuf_spin_lock(&seg->pool->lock);
+			circstringbuf_pool_requeue(seg->pool, seg);
+			circstringbuf_spin_unlock(&seg->pool->lock);
+		}
+		seg->tail = page;
+	}
+
+	memcpy(seg->tail->data + seg->tail->tail, string, len);
+	seg->tail->tail += len;
+	seg->tail->count++;
+
+	circstringbuf_spin_unlock(&seg->lock);
+
+	return result;
+}
+
+/*
+ * find the page holding the oldest string, drained pages are returned
+ * to the pool on the way
+ *
+ * AI: CALLER HOLDS THE BUFFER LOCK
+ */
+static circstringbuf_page_t *
+circstringbuf_seg_front(circstringbuf_seg_t *seg) {
+
+	if (seg->head && seg->head->head == seg->head->tail) {
+
+		circstringbuf_spin_lock(&seg->pool->lock);
+		while (seg->head && seg->head->head == seg->head->tail)
+			circstringbuf_seg_shift(seg);
+		circstringbuf_spin_unlock(&seg->pool->lock);
+	}
+
+	return seg->head;
+}
+
+/*
+ * consume the oldest string of the page, return the page to the pool
+ * once it is drained
+ *
+ * AI: CALLER HOLDS THE BUFFER LOCK
+ */
+static void
+circstringbuf_seg_consume(circstringbuf_seg_t *seg, circstringbuf_page_t *page,
+	size_t len) {
+
+	page->head += len + 1;
+	page->count--;
+	if (page->head == page->tail) {
+
+		circstringbuf_spin_lock(&seg->pool->lock);
+		circstringbuf_seg_shift(seg);
+		circstringbuf_spin_unlock(&seg->pool->lock);
+	}
+}
+
+/*
+ * return the length of string to be popped by the next
+ * circstringbuf_seg_pop()
+ */
+int
+circstringbuf_seg_strlen(circstringbuf_seg_t *seg, size_t *size) {
+
+	if (!seg || !seg->pool || !size)
+		return CIRCBUF_ERROR;
+
+	circstringbuf_spin_lock(&seg->lock);
+
+circstringbuf_page_t *page = circstringbuf_seg_front(seg);
+
+	if (page)
+		*size = strlen(page->data + page->head);
+
+	circstringbuf_spin_unlock(&seg->lock);
+
+	return page ? CIRCBUF_OK : CIRCBUF_EMPTY;
+}
+
+/*
+ * pop string from segmented buffer
+ *
+ * AI: USES PREALLOCATED BUFFER - "string" should have sufficient
+ *     space to hold value copied to it by the function
+ */
+int
+circstringbuf_seg_pop(circstringbuf_seg_t *seg, char *string) {
+
+	if (!seg || !seg->pool || !string)
+		return CIRCBUF_ERROR;
+
+	circstringbuf_spin_lock(&seg->lock);
+
+circstringbuf_page_t *page = circstringbuf_seg_front(seg);
+
+	if (page) {
+
+size_t len = strlen(page->data + page->head);
+
+		memcpy(string, page->data + page->head, len + 1);
+		circstringbuf_seg_consume(seg, page, len);
+	}
+
+	circstringbuf_spin_unlock(&seg->lock);
+
+	return page ? CIRCBUF_OK : CIRCBUF_EMPTY;
+}
+
+/*
+ * pop string from segmented buffer to nowhere (i.e, drop it away)
+ */
+int
+circstringbuf_seg_drop(circstringbuf_seg_t *seg) {
+
+	if (!seg || !seg->pool)
+		return CIRCBUF_ERROR;
+
+	circstringbuf_spin_lock(&seg->lock);
+
+circstringbuf_page_t *page = circstringbuf_seg_front(seg);
+
+	if (page)
+		circstringbuf_seg_consume(seg, page, strlen(page->data + page->head));
+
+	circstringbuf_spin_unlock(&seg->lock);
+
+	return page ? CIRCBUF_OK : CIRCBUF_EMPTY;
+}
@@ -0,0 +1,255 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "circstringbuf.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Page of segmented circular buffer.
+ *
+ * @field struct circstringbuf_page *next
+ *                              - next (newer) page of the buffer
+ * @field uint64_t stamp        - pool-wide allocation order of the page,
+ *                                i.e. the age of its oldest string
+ * @field uint32_t free_next    - index + 1 of the next page of the pool
+ *                                free list, 0 for the last one
+ * @field uint32_t head         - offset of the oldest string in the page
+ * @field uint32_t tail         - offset past the newest string in the page
+ * @field uint32_t count        - number of strings in the page
+ * @field char data[]           - strings, each '\0'-terminated
+ *
+ */
+typedef struct circstringbuf_page {
+
+	struct circstringbuf_page *next;
+	uint64_t stamp;
+	uint32_t free_next;
+	uint32_t head;
+	uint32_t tail;
+	uint32_t count;
+	char data[];
+} circstringbuf_page_t;
+
+typedef struct circstringbuf_seg circstringbuf_seg_t;
+
+/*
+ * Pool of fixed-size pages shared by segmented buffers.
+ *
+ * @field char *arena           - memory pages are carved from (const)
+ * @field size_t page_size      - size of page including its header (const)
+ * @field uint32_t pages        - number of pages in the arena (const)
+ * @field uint32_t budget       - maximum number of pages in use (const)
+ * @field uint64_t free_top     - lock-free free list top: ABA tag in
+ *                                the upper half, index + 1 of the page
+ *                                in the lower one
+ * @field uint32_t in_use       - number of pages taken from the pool
+ * @field uint64_t stamp        - last page allocation stamp
+ * @field bool lock             - spinlock protecting the list of buffers
+ * @field circstringbuf_seg_t *buffers
+ *                              - buffers holding pages, ordered by
+ *                                the stamp of their oldest page, so
+ *                                the first one is evicted from
+ * @field circstringbuf_seg_t *last
+ *                              - the last buffer of the list
+ *
+ */
+typedef struct {
+
+	char *arena;
+	size_t page_size;
+	uint32_t pages;
+	uint32_t budget;
+
+	uint64_t free_top;
+	uint32_t in_use;
+	uint64_t stamp;
+
+	bool lock;
+	circstringbuf_seg_t *buffers;
+	circstringbuf_seg_t *last;
+} circstringbuf_pool_t;
+
+/*
+ * Segmented circular buffer control structure.
+ *
+ * Storage of the buffer is the chain of pages taken from the pool as
+ * the buffer grows and returned as soon as they are drained. If the pool
+ * budget is exhausted, the oldest page of all the buffers of the pool is
+ * evicted. Since buffers evict each other, they are locked internally and
+ * don't use CIRCBUF_ACQUIRE/CIRCBUF_RELEASE.
+ *
+ * @field circstringbuf_pool_t *pool
+ *                              - pool pages are taken from (const)
+ * @field circstringbuf_page_t *head
+ *                              - the oldest page
+ * @field circstringbuf_page_t *tail
+ *                              - the newest page
+ * @field uint64_t oldest       - stamp of the oldest page, UINT64_MAX
+ *                                if there is no page
+ * @field uint64_t dropped      - number of strings evicted
+ * @field bool lock             - spinlock protecting the buffer
+ * @field circstringbuf_seg_t *prev
+ *                              - previous buffer of the pool list, i.e.
+ *                                the one with the older oldest page
+ * @field circstringbuf_seg_t *next
+ *                              - next buffer of the pool list
+ *
+ * Buffers are linked to the pool list while they hold any page.
+ *
+ */
+struct circstringbuf_seg {
+
+	circstringbuf_pool_t *pool;
+	circstringbuf_page_t *head;
+	circstringbuf_page_t *tail;
+	uint64_t oldest;
+	uint64_t dropped;
+
+	bool lock;
+	circstringbuf_seg_t *prev;
+	circstringbuf_seg_t *next;
+};
+
+/*
+ * initialize page pool
+ *
+ * @param circstringbuf_pool_t *pool
+ *                              - static pool object
+ * @param void *arena           - memory pages are carved from, aligned
+ *                                at least as uint64_t
+ * @param size_t arena_size     - size of the memory
+ * @param size_t page_size      - size of page including its header
+ * @param size_t budget         - maximum number of bytes taken by all
+ *                                the buffers of the pool, 0 if the whole
+ *                                arena may be used
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: unsafe
+ *
+ */
+int circstringbuf_pool_init(circstringbuf_pool_t *, void *, size_t,
+	size_t, size_t);
+
+/*
+ * initialize segmented buffer drawing pages from the pool
+ *
+ * @param circstringbuf_seg_t *seg
+ *                              - static segmented buffer object
+ * @param circstringbuf_pool_t *pool
+ *                              - pool to take pages from
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_seg_init(circstringbuf_seg_t *, circstringbuf_pool_t *);
+
+/*
+ * return all the pages of segmented buffer to the pool and detach it
+ *
+ * @param circstringbuf_seg_t *seg
+ *                              - segmented buffer object
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: safe             - as long as the buffer itself is not used
+ *                                concurrently
+ *
+ */
+int circstringbuf_seg_release(circstringbuf_seg_t *);
+
+/*
+ * push string to segmented buffer
+ *
+ * @param circstringbuf_seg_t *seg
+ *                              - segmented buffer object
+ * @param const char *string    - string that is copied to the buffer, it
+ *                                has to fit into one page
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_DATALOSS if the oldest page of
+ *                                the pool was evicted to fit the string
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_seg_push(circstringbuf_seg_t *, const char *);
+
+/*
+ * return the length of string to be popped by the next
+ * circstringbuf_seg_pop()
+ *
+ * @param circstringbuf_seg_t *seg
+ *                              - segmented buffer object
+ * @param size_t *size          - variable where the length of the first
+ *                                valid element is copied to
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if buffer is empty
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_seg_strlen(circstringbuf_seg_t *, size_t *);
+
+/*
+ * pop string from segmented buffer
+ *
+ * @param circstringbuf_seg_t *seg
+ *                              - segmented buffer object
+ * @param char *string          - string where the first valid element is
+ *                                copied to
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if buffer is empty
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_seg_pop(circstringbuf_seg_t *, char *);
+
+/*
+ * pop string from segmented buffer to nowhere (i.e, drop it away)
+ *
+ * @param circstringbuf_seg_t *seg
+ *                              - segmented buffer object
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if buffer is empty
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_seg_drop(circstringbuf_seg_t *);
+
+#if defined(__cplusplus)
+}
+#endif
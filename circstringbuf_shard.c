@@ -0,0 +1,298 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#	define _GNU_SOURCE
+#endif
+
+#include <sched.h>
+#include <string.h>
+
+#include "circstringbuf_shard.h"
+
+/*
+ * string being pushed to the shard
+ */
+typedef struct {
+	const char *string;
+	size_t len;
+} circstringbuf_shard_record_t;
+
+/*
+ * copy bytes to the given offset of the space allocated in one or two parts
+ */
+static void
+circstringbuf_shard_copy(char *part1, size_t size1, char *part2,
+	size_t offset, const char *source, size_t size) {
+
+	if (offset < size1) {
+
+size_t head = (size < size1 - offset) ? size : size1 - offset;
+
+		memcpy(part1 + offset, source, head);
+		source += head;
+		size -= head;
+		offset = size1;
+	}
+	if (size)
+		memcpy(part2 + offset - size1, source, size);
+}
+
+/*
+ * write the stamp and the string to the space allocated in the shard
+ *
+ * AI: STAMP IS TAKEN UNDER THE LOCK -- so that the shard stays ordered
+ */
+static void
+circstringbuf_shard_fill(void *ctx, char *part1, size_t size1, char *part2) {
+const circstringbuf_shard_record_t *record = ctx;
+char stamp[CIRCBUF_SHARD_STAMP];
+
+	circstringbuf_hex(stamp, CIRCBUF_SHARD_STAMP, circstringbuf_now());
+	circstringbuf_shard_copy(part1, size1, part2, 0, stamp,
+		CIRCBUF_SHARD_STAMP);
+	circstringbuf_shard_copy(part1, size1, part2, CIRCBUF_SHARD_STAMP,
+		record->string, record->len);
+}
+
+/*
+ * initialize sharded front end
+ */
+int
+circstringbuf_shards_init(circstringbuf_shards_t *shards, circstringbuf_t *cb,
+	size_t count, uint64_t window) {
+
+	if (!shards || !cb || !count)
+		return CIRCBUF_ERROR;
+
+	for (size_t i = 0; i < count; i++) {
+
+		if (cb[i].policy == CIRCBUF_PRIORITY)
+			return CIRCBUF_ERROR;
+	}
+
+	shards->shards = cb;
+	shards->count = count;
+	shards->window = window;
+	shards->lost = 0;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * push string to the shard of the given index
+ */
+int
+circstringbuf_shards_push_to(circstringbuf_shards_t *shards, size_t index,
+	const char *string) {
+
+	if (!shards || !string || index >= shards->count)
+		return CIRCBUF_ERROR;
+
+circstringbuf_shard_record_t record = {string, strlen(string)};
+
+	return circstringbuf_push_fill(&shards->shards[index],
+		CIRCBUF_SHARD_STAMP + record.len, circstringbuf_shard_fill, &record);
+}
+
+/*
+ * push string to the shard of the current CPU
+ */
+int
+circstringbuf_shards_push(circstringbuf_shards_t *shards, const char *string) {
+
+	if (!shards || !shards->count)
+		return CIRCBUF_ERROR;
+
+#if defined(__linux__)
+int cpu = sched_getcpu();
+
+	if (cpu >= 0)
+		return circstringbuf_shards_push_to(shards, cpu % shards->count,
+			string);
+#endif /* defined(__linux__) */
+
+	/*
+	 * CPU is unknown: shard per thread, assigned round-robin.
+	 */
+static size_t threads;
+static _Thread_local size_t thread;
+
+	if (!thread)
+		thread = __atomic_add_fetch(&threads, 1, __ATOMIC_RELAXED);
+
+	return circstringbuf_shards_push_to(shards, (thread - 1) % shards->count,
+		string);
+}
+
+/*
+ * parse the stamp of the string
+ */
+static uint64_t
+circstringbuf_shard_stamp(const char *head) {
+uint64_t stamp = 0;
+
+	for (int n = 0; n < CIRCBUF_SHARD_STAMP; n++)
+		stamp = (stamp << 4) | ((head[n] <= '9') ?
+			head[n] - '0' : head[n] - 'a' + 10);
+
+	return stamp;
+}
+
+/*
+ * pop the head string of the shard with its stamp skipped, if the stamp is
+ * still the one given
+ *
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if the head string is not
+ *                                the one stamped any more
+ *                              - CIRCBUF_FULL if it does not fit
+ *                              - CIRCBUF_ERROR on error
+ *
+ * AI: ONE CRITICAL SECTION -- a push evicting the head string between the
+ *     check and the copy would make the consumer pop the newer one
+ */
+static int
+circstringbuf_shard_take(circstringbuf_t *cb, uint64_t stamp, char *string,
+	size_t size, size_t *pLen) {
+char head[CIRCBUF_SHARD_STAMP];
+size_t len = 0;
+int result = CIRCBUF_EMPTY;
+
+#if defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_ACQUIRE_CONTEXT;
+#else /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+	CIRCBUF_ACQUIRE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+	if (!cb->empty) {
+
+		for (size_t position = cb->current_start;
+			cb->start[position] != cb->delim;
+			position = (position + 1) % cb->end) {
+
+			if (len < CIRCBUF_SHARD_STAMP)
+				head[len] = cb->start[position];
+			len++;
+		}
+	}
+
+	if (len < CIRCBUF_SHARD_STAMP ||
+		circstringbuf_shard_stamp(head) != stamp) {
+
+		result = CIRCBUF_EMPTY;
+	} else if (len - CIRCBUF_SHARD_STAMP >= size) {
+
+		if (pLen)
+			*pLen = len - CIRCBUF_SHARD_STAMP;
+		result = CIRCBUF_FULL;
+	} else {
+
+char *part1, *part2;
+size_t size1;
+
+		result = circstringbuf_span(cb, &part1, &size1, &part2);
+		if (result == CIRCBUF_OK) {
+
+			/*
+			 * The string spanned is the one checked, with the
+			 * delimiter turned into '\0'.
+			 */
+			if (!part2)
+				size1 = len + 1;
+			for (size_t i = CIRCBUF_SHARD_STAMP; i <= len; i++)
+				string[i - CIRCBUF_SHARD_STAMP] = (i < size1) ?
+					part1[i] : part2[i - size1];
+			if (pLen)
+				*pLen = len - CIRCBUF_SHARD_STAMP;
+		}
+	}
+
+#if !defined(CIRCBUF_ACQUIRE_CONTEXT)
+	CIRCBUF_RELEASE;
+#endif /* defined(CIRCBUF_ACQUIRE_CONTEXT) */
+
+	return result;
+}
+
+/*
+ * pop the oldest string of all the shards
+ *
+ * AI: K-WAY MERGE -- the head stamp of every shard is peeked, the string
+ *     with the oldest one is popped with its stamp skipped; if it has been
+ *     evicted meanwhile the shards are scanned again
+ */
+int
+circstringbuf_shards_pop(circstringbuf_shards_t *shards, char *string,
+	size_t size, size_t *pLen) {
+
+	if (!shards || !string || !size)
+		return CIRCBUF_ERROR;
+
+	for (;;) {
+
+uint64_t oldest = UINT64_MAX;
+size_t pick = shards->count;
+bool missing = false;
+
+		for (size_t i = 0; i < shards->count; i++) {
+
+char head[CIRCBUF_SHARD_STAMP + 1];
+size_t len = 0;
+int result = circstringbuf_peek(&shards->shards[i], head, sizeof(head),
+	&len);
+
+			if (result == CIRCBUF_EMPTY) {
+
+				missing = true;
+				continue;
+			}
+			if (result != CIRCBUF_OK || len < CIRCBUF_SHARD_STAMP)
+				return CIRCBUF_ERROR;
+
+uint64_t stamp = circstringbuf_shard_stamp(head);
+
+			if (stamp < oldest) {
+
+				oldest = stamp;
+				pick = i;
+			}
+		}
+
+		if (pick == shards->count)
+			return CIRCBUF_EMPTY;
+		if (missing && shards->window &&
+			oldest + shards->window * 1000000 > circstringbuf_now())
+			return CIRCBUF_EMPTY;
+
+int result = circstringbuf_shard_take(&shards->shards[pick], oldest, string,
+	size, pLen);
+
+		if (result != CIRCBUF_EMPTY)
+			return result;
+
+		/*
+		 * The string picked was evicted under the consumer.
+		 */
+		shards->lost++;
+	}
+}
@@ -0,0 +1,160 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "circstringbuf.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Length of the timestamp each string of the shard is prefixed with:
+ * nanoseconds of monotonic clock, hexadecimal, fixed width.
+ *
+ */
+#define CIRCBUF_SHARD_STAMP 16
+
+/*
+ * Sharded front end of the circular buffers.
+ *
+ * Each producer pushes to the shard of the CPU it runs on (of the thread
+ * where CPU is unknown), so pushes of different cores never meet on the
+ * same cursors. Strings are stamped on push under the lock of the shard,
+ * so every shard is ordered by itself; the single consumer merges the
+ * shards into one stream ordered by stamps.
+ *
+ * While some shard is empty, a string younger than the window is held
+ * back, since the empty shard may still get an older one. Strings
+ * arriving later than that may come out of order, i.e. the window bounds
+ * the reordering.
+ *
+ * CIRCBUF_ACQUIRE/CIRCBUF_RELEASE are to lock the buffer they are used
+ * with (cb) for the shards to scale.
+ *
+ * @field circstringbuf_t *shards
+ *                              - shards, initialized by the caller, with
+ *                                any policy but CIRCBUF_PRIORITY (const)
+ * @field size_t count          - number of shards (const)
+ * @field uint64_t window       - reordering window, ms, 0 if no string
+ *                                is held back
+ * @field uint64_t lost         - number of strings the consumer picked
+ *                                which the shard evicted before they
+ *                                were popped
+ *
+ */
+typedef struct {
+
+	circstringbuf_t *shards;
+	size_t count;
+	uint64_t window;
+
+	uint64_t lost;
+} circstringbuf_shards_t;
+
+/*
+ * initialize sharded front end
+ *
+ * @param circstringbuf_shards_t *shards
+ *                              - static sharded front end object
+ * @param circstringbuf_t *cb   - array of the shards initialized
+ * @param size_t count          - number of the shards
+ * @param uint64_t window       - reordering window, ms
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: unsafe
+ *
+ */
+int circstringbuf_shards_init(circstringbuf_shards_t *, circstringbuf_t *,
+	size_t, uint64_t);
+
+/*
+ * push string to the shard of the given index
+ *
+ * @param circstringbuf_shards_t *shards
+ *                              - sharded front end object
+ * @param size_t index          - index of the shard, e.g. the one of
+ *                                the producer thread
+ * @param const char *string    - string that is copied to the shard
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_DATALOSS if the oldest strings of
+ *                                the shard were evicted
+ *                              - CIRCBUF_FULL if the string does not fit
+ *                                and the policy of the shard is
+ *                                CIRCBUF_DROP_NEWEST
+ *                              - CIRCBUF_ERROR on error
+ *
+ * Policies are honored as circstringbuf_push() does, CIRCBUF_BLOCK waits
+ * until the consumer frees up enough space.
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_shards_push_to(circstringbuf_shards_t *, size_t,
+	const char *);
+
+/*
+ * push string to the shard of the current CPU
+ *
+ * @param circstringbuf_shards_t *shards
+ *                              - sharded front end object
+ * @param const char *string    - string that is copied to the shard
+ * @return enum                 - as circstringbuf_shards_push_to() does
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_shards_push(circstringbuf_shards_t *, const char *);
+
+/*
+ * pop the oldest string of all the shards
+ *
+ * @param circstringbuf_shards_t *shards
+ *                              - sharded front end object
+ * @param char *string          - string where the element is copied to
+ * @param size_t size           - size of the string
+ * @param size_t *pLen          - pointer to variable where the length of
+ *                                the element is stored to, may be NULL
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if all the shards are empty
+ *                                or the oldest string is held back
+ *                              - CIRCBUF_FULL if the element does not fit
+ *                                into size, see circstringbuf_pop_n()
+ *                              - CIRCBUF_ERROR on error
+ *
+ * Set the window to 0 to drain the shards completely.
+ *
+ * @mt-safety: unsafe           - one consumer at a time, producers may
+ *                                push concurrently
+ *
+ */
+int circstringbuf_shards_pop(circstringbuf_shards_t *, char *, size_t,
+	size_t *);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,309 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include "circstringbuf_shm.h"
+
+#if defined(CIRCBUF_POSIX)
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif /* defined(CIRCBUF_POSIX) */
+
+#define CIRCBUF_SEQ_STORE(__seq, __value) \
+	__atomic_store_n(&(__seq), (__value), __ATOMIC_RELEASE)
+
+/*
+ * return the size of memory region holding the buffer of the given size
+ */
+size_t
+circstringbuf_shm_size(size_t size) {
+
+	return sizeof(circstringbuf_shm_header_t) + size;
+}
+
+/*
+ * initialize shared memory buffer in the memory region
+ *
+ * AI: MAGIC IS STORED LAST -- attachers never see partially formatted
+ *     control block
+ */
+int
+circstringbuf_shm_format(circstringbuf_shm_t *shm, void *region,
+	size_t region_size) {
+
+	if (!shm || !region)
+		return CIRCBUF_ERROR;
+	if (region_size < circstringbuf_shm_size(2))
+		return CIRCBUF_ERROR;
+
+circstringbuf_shm_header_t *header = region;
+
+	memset(header, 0, sizeof(*header));
+	header->version = CIRCBUF_SHM_VERSION;
+	header->size = region_size - sizeof(*header);
+	header->data = sizeof(*header);
+	CIRCBUF_SEQ_STORE(header->magic, CIRCBUF_SHM_MAGIC);
+
+	return circstringbuf_shm_attach(shm, region, region_size, 0);
+}
+
+/*
+ * attach to shared memory buffer formatted by another process
+ */
+int
+circstringbuf_shm_attach(circstringbuf_shm_t *shm, void *region,
+	size_t region_size, size_t size) {
+
+	if (!shm || !region || region_size < sizeof(circstringbuf_shm_header_t))
+		return CIRCBUF_ERROR;
+
+circstringbuf_shm_header_t *header = region;
+
+	if (CIRCBUF_SEQ_LOAD(header->magic) != CIRCBUF_SHM_MAGIC)
+		return CIRCBUF_ERROR;
+	if (header->version != CIRCBUF_SHM_VERSION)
+		return CIRCBUF_ERROR;
+	if (header->size < 2 || (size && header->size != size))
+		return CIRCBUF_ERROR;
+	if (header->data < sizeof(*header) || header->data > region_size
+		|| header->size > region_size - header->data)
+		return CIRCBUF_ERROR;
+
+	shm->header = header;
+	shm->start = (char *)region + header->data;
+	shm->end = header->size;
+	shm->mapped = 0;
+
+	return CIRCBUF_OK;
+}
+
+#if defined(CIRCBUF_POSIX)
+/*
+ * map shared memory buffer from the file descriptor
+ */
+int
+circstringbuf_shm_map(circstringbuf_shm_t *shm, int fd, size_t size,
+	bool create) {
+size_t region_size = circstringbuf_shm_size(size);
+struct stat st;
+
+	if (!shm || fd < 0 || (create && size < 2))
+		return CIRCBUF_ERROR;
+
+	if (create) {
+
+		if (ftruncate(fd, region_size) != 0)
+			return CIRCBUF_ERROR;
+	} else {
+
+		if (fstat(fd, &st) != 0)
+			return CIRCBUF_ERROR;
+		region_size = st.st_size;
+	}
+
+void *region = mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+	fd, 0);
+
+	if (region == MAP_FAILED)
+		return CIRCBUF_ERROR;
+
+int result = create ? circstringbuf_shm_format(shm, region, region_size) :
+	circstringbuf_shm_attach(shm, region, region_size, size);
+
+	if (result != CIRCBUF_OK) {
+
+		munmap(region, region_size);
+
+		return CIRCBUF_ERROR;
+	}
+	shm->mapped = region_size;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * open shared memory buffer by name
+ */
+int
+circstringbuf_shm_open(circstringbuf_shm_t *shm, const char *name,
+	size_t size, bool create) {
+
+	if (!shm || !name)
+		return CIRCBUF_ERROR;
+
+int fd = shm_open(name, create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+
+	if (fd < 0)
+		return CIRCBUF_ERROR;
+
+int result = circstringbuf_shm_map(shm, fd, size, create);
+
+	close(fd);
+	if (result != CIRCBUF_OK && create)
+		shm_unlink(name);
+
+	return result;
+}
+
+/*
+ * unmap shared memory buffer mapped by circstringbuf_shm_map()
+ */
+int
+circstringbuf_shm_close(circstringbuf_shm_t *shm) {
+
+	if (!shm || !shm->header || !shm->mapped)
+		return CIRCBUF_ERROR;
+	if (munmap(shm->header, shm->mapped) != 0)
+		return CIRCBUF_ERROR;
+
+	shm->header = NULL;
+	shm->start = NULL;
+	shm->mapped = 0;
+
+	return CIRCBUF_OK;
+}
+#endif /* defined(CIRCBUF_POSIX) */
+
+/*
+ * push string to shared memory buffer
+ *
+ * AI: SINGLE PRODUCER -- seq_end is owned by the caller, seq_start is
+ *     only read to find out how much space the consumer has released
+ * AI: NEVER EVICTS -- the newest string is dropped if it does not fit
+ */
+int
+circstringbuf_shm_push(circstringbuf_shm_t *shm, const char *string) {
+
+	if (!shm || !shm->header || !string)
+		return CIRCBUF_ERROR;
+
+size_t len = strlen(string) + 1;
+
+	if (len > shm->end)
+		return CIRCBUF_ERROR;
+
+uint64_t tail = __atomic_load_n(&shm->header->seq_end, __ATOMIC_RELAXED);
+uint64_t head = CIRCBUF_SEQ_LOAD(shm->header->seq_start);
+
+	if (len > shm->end - (tail - head)) {
+
+		__atomic_add_fetch(&shm->header->dropped, 1, __ATOMIC_RELAXED);
+
+		return CIRCBUF_FULL;
+	}
+
+size_t offset = tail % shm->end;
+size_t part1 = (len < shm->end - offset) ? len : shm->end - offset;
+
+	memcpy(shm->start + offset, string, part1);
+	memcpy(shm->start, string + part1, len - part1);
+
+	/* Release store makes the string visible to the consumer. */
+	CIRCBUF_SEQ_STORE(shm->header->seq_end, tail + len);
+
+	return (len > part1) ? CIRCBUF_WRAP : CIRCBUF_OK;
+}
+
+/*
+ * find the length of the oldest string in the shared memory buffer
+ */
+static int
+circstringbuf_shm_head(circstringbuf_shm_t *shm, uint64_t *pHead,
+	size_t *pLen) {
+
+	if (!shm || !shm->header)
+		return CIRCBUF_ERROR;
+
+uint64_t head = __atomic_load_n(&shm->header->seq_start, __ATOMIC_RELAXED);
+uint64_t tail = CIRCBUF_SEQ_LOAD(shm->header->seq_end);
+
+	if (tail == head)
+		return CIRCBUF_EMPTY;
+
+size_t offset = head % shm->end;
+size_t part1 = (tail - head < shm->end - offset) ? tail - head :
+	shm->end - offset;
+const char *terminator = memchr(shm->start + offset, '\0', part1);
+
+	if (terminator) {
+
+		*pLen = terminator - (shm->start + offset);
+	} else {
+
+		terminator = memchr(shm->start, '\0', tail - head - part1);
+		if (!terminator)
+			return CIRCBUF_ERROR;
+		*pLen = part1 + (terminator - shm->start);
+	}
+	*pHead = head;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * return the length of string to be popped by the next
+ * circstringbuf_shm_pop()
+ */
+int
+circstringbuf_shm_strlen(circstringbuf_shm_t *shm, size_t *size) {
+uint64_t head;
+
+	if (!size)
+		return CIRCBUF_ERROR;
+
+	return circstringbuf_shm_head(shm, &head, size);
+}
+
+/*
+ * pop string from shared memory buffer
+ *
+ * AI: USES PREALLOCATED BUFFER - "string" should have sufficient
+ *     space to hold value copied to it by the function
+ * AI: SINGLE CONSUMER -- seq_start is owned by the caller
+ */
+int
+circstringbuf_shm_pop(circstringbuf_shm_t *shm, char *string) {
+uint64_t head;
+size_t len;
+
+	if (!string)
+		return CIRCBUF_ERROR;
+
+int result = circstringbuf_shm_head(shm, &head, &len);
+
+	if (result != CIRCBUF_OK)
+		return result;
+
+size_t offset = head % shm->end;
+size_t part1 = (len + 1 < shm->end - offset) ? len + 1 : shm->end - offset;
+
+	memcpy(string, shm->start + offset, part1);
+	memcpy(string + part1, shm->start, len + 1 - part1);
+
+	/* Release store hands the space over to the producer. */
+	CIRCBUF_SEQ_STORE(shm->header->seq_start, head + len + 1);
+
+	return CIRCBUF_OK;
+}
@@ -0,0 +1,249 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "circstringbuf.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define CIRCBUF_SHM_MAGIC 0x46425343 /* "CSBF" */
+#define CIRCBUF_SHM_VERSION 1
+
+/*
+ * Shared memory circular buffer control block.
+ *
+ * Control block is followed by the data in the same memory region and
+ * refers to it by offset, so the region may be mapped at different
+ * addresses in different processes. Cursors written by the producer and
+ * by the consumer are kept on separate cache lines.
+ *
+ * @field uint32_t magic        - CIRCBUF_SHM_MAGIC once formatted
+ * @field uint32_t version      - CIRCBUF_SHM_VERSION
+ * @field uint64_t size         - size of the data area (const)
+ * @field uint64_t data         - offset of the data area from the control
+ *                                block (const)
+ * @field uint64_t seq_start    - total number of bytes ever popped, written
+ *                                by the consumer only
+ * @field uint64_t seq_end      - total number of bytes ever pushed, written
+ *                                by the producer only
+ * @field uint64_t dropped      - number of strings dropped by the producer
+ *                                because the buffer was full
+ *
+ */
+typedef struct {
+
+	uint32_t magic;
+	uint32_t version;
+	uint64_t size;
+	uint64_t data;
+	char reserved1[40];
+
+	uint64_t seq_start;
+	char reserved2[56];
+
+	uint64_t seq_end;
+	uint64_t dropped;
+	char reserved3[48];
+} circstringbuf_shm_header_t;
+
+/*
+ * Process-local handle of the shared memory circular buffer.
+ *
+ * @field circstringbuf_shm_header_t *header
+ *                              - control block as mapped in this process
+ * @field char *start           - data area as mapped in this process
+ * @field size_t end            - size of the data area
+ * @field size_t mapped         - size of the mapping owned by the handle,
+ *                                0 if the memory is managed by the caller
+ *
+ */
+typedef struct {
+
+	circstringbuf_shm_header_t *header;
+	char *start;
+	size_t end;
+	size_t mapped;
+} circstringbuf_shm_t;
+
+/*
+ * return the size of memory region holding the buffer of the given size
+ *
+ * @param size_t size           - size of the data area
+ * @return size_t               - size of the memory region
+ *
+ * @mt-safety: safe
+ *
+ */
+size_t circstringbuf_shm_size(size_t);
+
+/*
+ * initialize shared memory buffer in the memory region
+ *
+ * @param circstringbuf_shm_t *shm
+ *                              - handle to initialize
+ * @param void *region          - memory region, the data area occupies
+ *                                everything past the control block
+ * @param size_t region_size    - size of memory region
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: unsafe           - nobody should be attached to the region
+ *                                while it is formatted
+ *
+ */
+int circstringbuf_shm_format(circstringbuf_shm_t *, void *, size_t);
+
+/*
+ * attach to shared memory buffer formatted by another process
+ *
+ * @param circstringbuf_shm_t *shm
+ *                              - handle to initialize
+ * @param void *region          - memory region
+ * @param size_t region_size    - size of memory region
+ * @param size_t size           - expected size of the data area, 0 if any
+ *                                size is acceptable
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR if the region is not
+ *                                formatted, has incompatible version or
+ *                                capacity
+ *
+ * @mt-safety: safe
+ *
+ */
+int circstringbuf_shm_attach(circstringbuf_shm_t *, void *, size_t,
+	size_t);
+
+#if defined(CIRCBUF_POSIX)
+/*
+ * map shared memory buffer from the file descriptor
+ *
+ * @param circstringbuf_shm_t *shm
+ *                              - handle to initialize
+ * @param int fd                - descriptor of shm_open()'ed object or
+ *                                memfd, may be closed once mapped
+ * @param size_t size           - size of the data area, 0 to accept any
+ *                                when attaching
+ * @param bool create           - true to size and format the object, false
+ *                                to attach to already formatted one
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: unsafe           - see circstringbuf_shm_format()
+ *
+ */
+int circstringbuf_shm_map(circstringbuf_shm_t *, int, size_t, bool);
+
+/*
+ * open shared memory buffer by name
+ *
+ * @param circstringbuf_shm_t *shm
+ *                              - handle to initialize
+ * @param const char *name      - shm_open() object name
+ * @param size_t size           - size of the data area, 0 to accept any
+ *                                when attaching
+ * @param bool create           - true to create and format the object,
+ *                                false to attach to the existing one
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: unsafe           - see circstringbuf_shm_format()
+ *
+ */
+int circstringbuf_shm_open(circstringbuf_shm_t *, const char *, size_t,
+	bool);
+
+/*
+ * unmap shared memory buffer mapped by circstringbuf_shm_map()
+ *
+ * @param circstringbuf_shm_t *shm
+ *                              - handle to release
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: unsafe
+ *
+ */
+int circstringbuf_shm_close(circstringbuf_shm_t *);
+#endif /* defined(CIRCBUF_POSIX) */
+
+/*
+ * push string to shared memory buffer
+ *
+ * @param circstringbuf_shm_t *shm
+ *                              - shared memory buffer handle
+ * @param const char *string    - string that is copied to the buffer
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_WRAP if buffer wrapping has
+ *                                occured
+ *                              - CIRCBUF_FULL if the consumer lags behind
+ *                                and the string was dropped
+ *                              - CIRCBUF_ERROR on error
+ *
+ * The producer never evicts strings the consumer has not popped yet: the
+ * newest string is dropped instead and counted in header->dropped.
+ *
+ * @mt-safety: single producer  - lock-free, no system calls
+ *
+ */
+int circstringbuf_shm_push(circstringbuf_shm_t *, const char *);
+
+/*
+ * return the length of string to be popped by the next
+ * circstringbuf_shm_pop()
+ *
+ * @param circstringbuf_shm_t *shm
+ *                              - shared memory buffer handle
+ * @param size_t *size          - variable where the length of the first
+ *                                valid element is copied to
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if buffer is empty
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: single consumer  - lock-free, no system calls
+ *
+ */
+int circstringbuf_shm_strlen(circstringbuf_shm_t *, size_t *);
+
+/*
+ * pop string from shared memory buffer
+ *
+ * @param circstringbuf_shm_t *shm
+ *                              - shared memory buffer handle
+ * @param char *string          - string where the first valid element is
+ *                                copied to
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if buffer is empty
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: single consumer  - lock-free, no system calls
+ *
+ */
+int circstringbuf_shm_pop(circstringbuf_shm_t *, char *);
+
+#if defined(__cplusplus)
+}
+#endif
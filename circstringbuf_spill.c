@@ -0,0 +1,274 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "circstringbuf_spill.h"
+
+#if defined(CIRCBUF_POSIX)
+#	include <unistd.h>
+
+/*
+ * write all the bytes to the file at the offset given
+ */
+static size_t
+circstringbuf_spill_write(int fd, const char *data, size_t size,
+	uint64_t offset) {
+size_t written = 0;
+
+	while (written < size) {
+
+ssize_t result = pwrite(fd, data + written, size - written,
+	offset + written);
+
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result <= 0)
+			break;
+		written += result;
+	}
+
+	return written;
+}
+
+/*
+ * write the strings staged to the file
+ */
+int
+circstringbuf_spill_flush(circstringbuf_spill_t *spill) {
+
+	if (!spill)
+		return CIRCBUF_ERROR;
+
+size_t size = spill->wtail - spill->whead;
+size_t written = circstringbuf_spill_write(spill->fd,
+	spill->wbuf + spill->whead, size, spill->woff);
+
+	/*
+	 * What was written is in the file already, whatever has happened
+	 * to the rest.
+	 */
+	spill->whead += written;
+	spill->woff += written;
+	if (written < size)
+		return CIRCBUF_ERROR;
+
+	spill->whead = spill->wtail = 0;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * store the strings evicted, see circstringbuf_tier_t
+ *
+ * AI: CALLED UNDER BUFFER LOCK -- no more than one write() per chunk
+ */
+static int
+circstringbuf_spill_put(void *ctx, const char *part1, size_t size1,
+	const char *part2, size_t size2) {
+circstringbuf_spill_t *spill = ctx;
+
+	if (size1 + size2 > spill->chunk)
+		return CIRCBUF_ERROR;
+
+	if (spill->wtail + size1 + size2 > spill->chunk) {
+
+		if (circstringbuf_spill_flush(spill) != CIRCBUF_OK)
+			return CIRCBUF_ERROR;
+	}
+
+	memcpy(spill->wbuf + spill->wtail, part1, size1);
+	memcpy(spill->wbuf + spill->wtail + size1, part2, size2);
+	spill->wtail += size1 + size2;
+	spill->spilled += size1 + size2;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * find the oldest string spilled
+ *
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if there is none
+ *                              - CIRCBUF_ERROR if the file read failed
+ * @param char delim            - delimiter of the strings
+ * @param char **pString        - variable set to pointer to the string
+ * @param size_t **ppHead       - variable set to pointer to the offset
+ *                                to advance to consume the string
+ */
+static int
+circstringbuf_spill_next(circstringbuf_spill_t *spill, char delim,
+	char **pString, size_t **ppHead) {
+
+	for (;;) {
+
+char *string = spill->rbuf + spill->rhead;
+
+		if (spill->rhead < spill->rtail &&
+			memchr(string, delim, spill->rtail - spill->rhead)) {
+
+			*pString = string;
+			*ppHead = &spill->rhead;
+
+			return CIRCBUF_OK;
+		}
+
+		if (spill->roff == spill->woff)
+			break;
+
+		/*
+		 * Read the next chunk keeping the beginning of the string
+		 * split by the previous one.
+		 */
+		memmove(spill->rbuf, string, spill->rtail - spill->rhead);
+		spill->rtail -= spill->rhead;
+		spill->rhead = 0;
+
+size_t size = spill->chunk - spill->rtail;
+ssize_t result;
+
+		if (size > spill->woff - spill->roff)
+			size = spill->woff - spill->roff;
+		do {
+
+			result = pread(spill->fd, spill->rbuf + spill->rtail, size,
+				spill->roff);
+		} while (result < 0 && errno == EINTR);
+
+		/*
+		 * The strings left in the file must not be skipped for the
+		 * newer ones.
+		 */
+		if (result <= 0)
+			return CIRCBUF_ERROR;
+
+		spill->rtail += result;
+		spill->roff += result;
+	}
+
+	/*
+	 * The file is read through, start it over.
+	 */
+	spill->roff = spill->woff = 0;
+
+	if (spill->rhead < spill->rtail) {
+
+		/*
+		 * The string was cut by a short write, its rest is still
+		 * staged. Both fit into the chunk, as they were staged together.
+		 */
+		memmove(spill->rbuf, spill->rbuf + spill->rhead,
+			spill->rtail - spill->rhead);
+		spill->rtail -= spill->rhead;
+		spill->rhead = 0;
+		memcpy(spill->rbuf + spill->rtail, spill->wbuf + spill->whead,
+			spill->wtail - spill->whead);
+		spill->rtail += spill->wtail - spill->whead;
+		spill->whead = spill->wtail = 0;
+
+		*pString = spill->rbuf;
+		*ppHead = &spill->rhead;
+
+		return CIRCBUF_OK;
+	}
+	spill->rhead = spill->rtail = 0;
+
+	if (spill->whead < spill->wtail) {
+
+		*pString = spill->wbuf + spill->whead;
+		*ppHead = &spill->whead;
+
+		return CIRCBUF_OK;
+	}
+
+	return CIRCBUF_EMPTY;
+}
+
+/*
+ * take the oldest string spilled, see circstringbuf_tier_t
+ */
+static int
+circstringbuf_spill_get(void *ctx, char delim, char *string, size_t *pSize) {
+circstringbuf_spill_t *spill = ctx;
+size_t *pHead;
+char *next;
+int result = circstringbuf_spill_next(spill, delim, &next, &pHead);
+
+	if (result != CIRCBUF_OK)
+		return result;
+
+size_t left = (pHead == &spill->rhead) ? spill->rtail - spill->rhead :
+	spill->wtail - spill->whead;
+char *end = memchr(next, delim, left);
+
+	/*
+	 * The strings were spilled with another delimiter, or cut short.
+	 */
+	if (!end)
+		return CIRCBUF_ERROR;
+
+size_t len = end - next;
+
+	if (string) {
+
+		memcpy(string, next, len);
+		string[len] = '\0';
+		*pHead += len + 1;
+	} else if (pSize) {
+
+		*pSize = len;
+	} else {
+
+		*pHead += len + 1;
+	}
+
+	if (spill->whead == spill->wtail)
+		spill->whead = spill->wtail = 0;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * initialize spill-to-disk overflow tier
+ */
+int
+circstringbuf_spill_init(circstringbuf_spill_t *spill, int fd, char *memory,
+	size_t memory_size) {
+
+	if (!spill || fd < 0 || !memory || memory_size < 2)
+		return CIRCBUF_ERROR;
+	if (ftruncate(fd, 0) < 0)
+		return CIRCBUF_ERROR;
+
+	memset(spill, 0, sizeof(*spill));
+	spill->tier.put = circstringbuf_spill_put;
+	spill->tier.get = circstringbuf_spill_get;
+	spill->tier.ctx = spill;
+	spill->fd = fd;
+	spill->chunk = memory_size / 2;
+	spill->wbuf = memory;
+	spill->rbuf = memory + spill->chunk;
+
+	return CIRCBUF_OK;
+}
+#endif /* defined(CIRCBUF_POSIX) */
@@ -0,0 +1,117 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "circstringbuf.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if defined(CIRCBUF_POSIX)
+/*
+ * Overflow tier spilling the strings evicted from the buffer to the file.
+ *
+ * Strings evicted are staged in the memory chunk and appended to the file
+ * as the chunk fills up, i.e. the file is written sequentially in big
+ * pieces. They are read back the same way: the file is read chunk by
+ * chunk, then the strings still staged are taken. Once everything written
+ * is read back the file is reused from its beginning.
+ *
+ * @field circstringbuf_tier_t tier
+ *                              - tier to attach by circstringbuf_set_tier()
+ * @field int fd                - file descriptor of the segment file (const)
+ * @field size_t chunk          - size of staging and of read chunks (const)
+ * @field char *wbuf            - staging chunk (const)
+ * @field size_t whead          - offset of the oldest string staged
+ * @field size_t wtail          - offset past the newest string staged
+ * @field char *rbuf            - read chunk (const)
+ * @field size_t rhead          - offset of the oldest string read
+ * @field size_t rtail          - offset past the data read
+ * @field uint64_t woff         - offset of the file end
+ * @field uint64_t roff         - offset of the data not read yet
+ * @field uint64_t spilled      - number of bytes ever spilled
+ *
+ */
+typedef struct {
+
+	circstringbuf_tier_t tier;
+	int fd;
+	size_t chunk;
+
+	char *wbuf;
+	size_t whead;
+	size_t wtail;
+
+	char *rbuf;
+	size_t rhead;
+	size_t rtail;
+
+	uint64_t woff;
+	uint64_t roff;
+	uint64_t spilled;
+} circstringbuf_spill_t;
+
+/*
+ * initialize spill-to-disk overflow tier
+ *
+ * @param circstringbuf_spill_t *spill
+ *                              - static spill object
+ * @param int fd                - segment file descriptor opened for
+ *                                reading and writing, it is truncated
+ * @param char *memory          - memory for staging and read chunks
+ * @param size_t memory_size    - size of the memory, each chunk takes
+ *                                a half of it, which has to be at least
+ *                                the size of the buffer spilled
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * Attach the tier by circstringbuf_set_tier(cb, &spill->tier).
+ *
+ * @mt-safety: unsafe
+ *
+ */
+int circstringbuf_spill_init(circstringbuf_spill_t *, int, char *, size_t);
+
+/*
+ * write the strings staged to the file
+ *
+ * @param circstringbuf_spill_t *spill
+ *                              - spill object
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR if write() failed
+ *
+ * Done implicitly as staging chunk fills up.
+ *
+ * @mt-safety: unsafe           - call it with the buffer the tier is
+ *                                attached to locked
+ *
+ */
+int circstringbuf_spill_flush(circstringbuf_spill_t *);
+#endif /* defined(CIRCBUF_POSIX) */
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,113 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include "circstringbuf_stage.h"
+
+/*
+ * initialize staging area
+ */
+int
+circstringbuf_stage_init(circstringbuf_stage_t *stage, circstringbuf_t *cb,
+	void *memory, size_t size, uint64_t interval) {
+
+	if (!stage || !cb || !memory || !size || size > cb->end)
+		return CIRCBUF_ERROR;
+
+	memset(stage, 0, sizeof(*stage));
+	stage->cb = cb;
+	stage->memory = memory;
+	stage->size = size;
+	stage->interval = interval;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * push all the strings staged to the shared buffer
+ */
+int
+circstringbuf_stage_flush(circstringbuf_stage_t *stage) {
+
+	if (!stage || !stage->cb)
+		return CIRCBUF_ERROR;
+	if (!stage->used)
+		return CIRCBUF_OK;
+
+int result = circstringbuf_push_bulk(stage->cb, stage->memory, stage->used,
+	stage->count);
+
+	if (result == CIRCBUF_FULL || result == CIRCBUF_ERROR)
+		stage->lost += stage->count;
+
+	stage->used = 0;
+	stage->count = 0;
+
+	return result;
+}
+
+/*
+ * stage string to be pushed to the shared buffer
+ *
+ * AI: NO LOCK IS TAKEN unless the block is flushed
+ */
+int
+circstringbuf_stage_push(circstringbuf_stage_t *stage, const char *string) {
+
+	if (!stage || !stage->cb || !string)
+		return CIRCBUF_ERROR;
+
+size_t len = strlen(string) + 1;
+int result = CIRCBUF_OK;
+
+	if (stage->used + len > stage->size)
+		result = circstringbuf_stage_flush(stage);
+
+	if (len > stage->size) {
+
+int pushed = circstringbuf_push_n(stage->cb, string, len - 1);
+
+		if (pushed == CIRCBUF_FULL || pushed == CIRCBUF_ERROR)
+			stage->lost++;
+
+		return (result == CIRCBUF_OK) ? pushed : result;
+	}
+
+	if (!stage->used && stage->interval)
+		stage->stamp = circstringbuf_now() / 1000000;
+	memcpy(stage->memory + stage->used, string, len - 1);
+	stage->memory[stage->used + len - 1] = stage->cb->delim;
+	stage->used += len;
+	stage->count++;
+
+	if (stage->interval &&
+		circstringbuf_now() / 1000000 - stage->stamp >= stage->interval) {
+
+int flushed = circstringbuf_stage_flush(stage);
+
+		if (flushed != CIRCBUF_OK)
+			result = flushed;
+	}
+
+	return result;
+}
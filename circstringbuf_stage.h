@@ -0,0 +1,130 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "circstringbuf.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Staging area of one producer thread.
+ *
+ * Strings are appended to the private memory of the thread with no lock
+ * and are pushed to the shared buffer as one block by
+ * circstringbuf_push_bulk(), so the cost of the contended push is paid
+ * once per block. The block is flushed when the next string does not fit,
+ * when the oldest string staged is older than the interval, or on demand.
+ * Strings of the thread keep their order.
+ *
+ * @field circstringbuf_t *cb   - shared buffer flushed to (const)
+ * @field char *memory          - staging memory (const)
+ * @field size_t size           - size of the memory (const)
+ * @field uint64_t interval     - maximum age of the string staged, ms,
+ *                                0 if strings are flushed only when the
+ *                                memory is full or on demand (const)
+ * @field size_t used           - number of bytes staged
+ * @field size_t count          - number of strings staged
+ * @field uint64_t stamp        - time the oldest string was staged, ms
+ * @field uint64_t lost         - number of strings staged the shared
+ *                                buffer refused
+ *
+ */
+typedef struct {
+
+	circstringbuf_t *cb;
+	char *memory;
+	size_t size;
+	uint64_t interval;
+
+	size_t used;
+	size_t count;
+	uint64_t stamp;
+	uint64_t lost;
+} circstringbuf_stage_t;
+
+/*
+ * initialize staging area
+ *
+ * @param circstringbuf_stage_t *stage
+ *                              - staging area object, thread-local
+ * @param circstringbuf_t *cb   - shared buffer to flush to
+ * @param void *memory          - staging memory, not larger than the
+ *                                shared buffer is
+ * @param size_t size           - size of the memory
+ * @param uint64_t interval     - maximum age of the string staged, ms,
+ *                                0 for no timer
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error
+ *
+ * @mt-safety: unsafe
+ *
+ */
+int circstringbuf_stage_init(circstringbuf_stage_t *, circstringbuf_t *,
+	void *, size_t, uint64_t);
+
+/*
+ * stage string to be pushed to the shared buffer
+ *
+ * @param circstringbuf_stage_t *stage
+ *                              - staging area object
+ * @param const char *string    - string that is copied
+ * @return enum                 - CIRCBUF_OK if the string is staged or
+ *                                no flush was needed
+ *                              - as circstringbuf_push_bulk() does
+ *                                otherwise, for the block flushed
+ *
+ * Strings larger than the staging memory are pushed to the shared buffer
+ * directly, after the ones staged are flushed.
+ *
+ * @mt-safety: unsafe           - the staging area is owned by one thread,
+ *                                the shared buffer is locked as usual
+ *
+ */
+int circstringbuf_stage_push(circstringbuf_stage_t *, const char *);
+
+/*
+ * push all the strings staged to the shared buffer
+ *
+ * @param circstringbuf_stage_t *stage
+ *                              - staging area object
+ * @return enum                 - CIRCBUF_OK if nothing is staged
+ *                              - as circstringbuf_push_bulk() does
+ *                                otherwise
+ *
+ * Strings the shared buffer refuses (CIRCBUF_FULL, CIRCBUF_ERROR) are
+ * counted as lost and dropped. Call it before the thread exits, or
+ * periodically if the thread may stay idle with strings staged.
+ *
+ * @mt-safety: unsafe           - see circstringbuf_stage_push()
+ *
+ */
+int circstringbuf_stage_flush(circstringbuf_stage_t *);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,383 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "circstringbuf_uring.h"
+
+#if defined(CIRCBUF_URING)
+#	include <unistd.h>
+#	include <linux/io_uring.h>
+#	include <sys/mman.h>
+#	include <sys/syscall.h>
+
+/*
+ * user_data of a write is its index, of the fsync linked to it the index
+ * with the bit set
+ */
+#define CIRCBUF_URING_SYNC ((uint64_t)1 << 63)
+
+#define CIRCBUF_URING_AT(__base, __offset) \
+	((void *)((char *)(__base) + (__offset)))
+
+/*
+ * take the next submission queue entry, the caller checks for the room
+ */
+static struct io_uring_sqe *
+circstringbuf_uring_sqe(circstringbuf_uring_t *uring) {
+unsigned index = (*uring->sq_tail + uring->sq_queued) & *uring->sq_mask;
+struct io_uring_sqe *sqe = &uring->sqes[index];
+
+	memset(sqe, 0, sizeof(*sqe));
+	uring->sq_array[index] = index;
+	uring->sq_queued++;
+	uring->pending++;
+
+	return sqe;
+}
+
+/*
+ * queue the rest of the write, with fsync linked if asked to
+ */
+static int
+circstringbuf_uring_queue(circstringbuf_uring_t *uring, unsigned index) {
+circstringbuf_write_t *request = &uring->writes[index];
+bool sync = uring->flags & CIRCBUF_URING_FSYNC;
+unsigned tail = *uring->sq_tail + uring->sq_queued;
+
+	/*
+	 * The write and its fsync are queued both or none, a write without
+	 * the fsync would never be done.
+	 */
+	if (tail - __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE) +
+		(sync ? 2 : 1) > uring->sq_entries)
+		return CIRCBUF_ERROR;
+
+struct io_uring_sqe *sqe = circstringbuf_uring_sqe(uring);
+
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = uring->fd;
+	sqe->addr = (uintptr_t)(uring->cb->start + request->seq % uring->cb->end);
+	sqe->len = request->end - request->seq;
+	sqe->off = request->offset;
+	sqe->user_data = index;
+	request->written = false;
+
+	if (sync) {
+
+		sqe->flags |= IOSQE_IO_LINK;
+		sqe = circstringbuf_uring_sqe(uring);
+		sqe->opcode = IORING_OP_FSYNC;
+		sqe->fd = uring->fd;
+		sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+		sqe->user_data = index | CIRCBUF_URING_SYNC;
+	}
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * submit the entries queued, optionally waiting for a completion
+ */
+static int
+circstringbuf_uring_enter(circstringbuf_uring_t *uring, bool wait) {
+unsigned queued = uring->sq_queued;
+
+	__atomic_store_n(uring->sq_tail, *uring->sq_tail + queued,
+		__ATOMIC_RELEASE);
+	uring->sq_queued = 0;
+
+	if (!queued && !wait)
+		return CIRCBUF_OK;
+
+	while (syscall(__NR_io_uring_enter, uring->ring_fd, queued,
+		wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0) < 0) {
+
+		if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+
+			uring->error = -errno;
+
+			return CIRCBUF_ERROR;
+		}
+		queued = 0;
+	}
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * process completions, requeue short writes and release data written
+ */
+static int
+circstringbuf_uring_reap(circstringbuf_uring_t *uring) {
+unsigned head = *uring->cq_head;
+unsigned tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; head++) {
+
+const struct io_uring_cqe *cqe = &uring->cqes[head & *uring->cq_mask];
+unsigned index = cqe->user_data & ~CIRCBUF_URING_SYNC;
+circstringbuf_write_t *request = &uring->writes[index];
+
+		uring->pending--;
+
+		/*
+		 * The fsync completes the write, unless it is canceled: the link
+		 * is broken by a failed or short write, which is handled by its
+		 * own completion.
+		 */
+		if (cqe->user_data & CIRCBUF_URING_SYNC) {
+
+			if (cqe->res == -ECANCELED)
+				continue;
+			if (cqe->res < 0) {
+
+				if (!uring->error)
+					uring->error = cqe->res;
+				continue;
+			}
+			if (request->written)
+				request->done = true;
+			continue;
+		}
+
+		if (cqe->res < 0 && cqe->res != -EINTR && cqe->res != -EAGAIN) {
+
+			if (!uring->error)
+				uring->error = cqe->res;
+			continue;
+		}
+
+		/*
+		 * A write of nothing is not retried, it would be forever.
+		 */
+		if (cqe->res == 0 && request->seq != request->end) {
+
+			if (!uring->error)
+				uring->error = -EIO;
+			continue;
+		}
+
+		if (cqe->res > 0) {
+
+			request->seq += cqe->res;
+			request->offset += cqe->res;
+		}
+		if (request->seq == request->end) {
+
+			request->written = true;
+			if (!(uring->flags & CIRCBUF_URING_FSYNC))
+				request->done = true;
+		} else if (!uring->error &&
+			circstringbuf_uring_queue(uring, index) != CIRCBUF_OK)
+			uring->error = -EBUSY;
+	}
+	__atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+
+	/*
+	 * Writes complete in any order, but the buffer is released from its
+	 * start only.
+	 */
+uint64_t completed = uring->completed;
+
+	while (uring->inflight && uring->writes[uring->first].done) {
+
+		completed = uring->writes[uring->first].end;
+		uring->first = (uring->first + 1) % CIRCBUF_URING_DEPTH;
+		uring->inflight--;
+	}
+	if (completed != uring->completed) {
+
+		circstringbuf_advance(uring->cb, completed - uring->completed);
+		uring->completed = completed;
+	}
+
+	return uring->error ? CIRCBUF_ERROR : CIRCBUF_OK;
+}
+
+/*
+ * submit writes of the data pushed since the previous submission
+ */
+static void
+circstringbuf_uring_submit(circstringbuf_uring_t *uring) {
+circstringbuf_t *cb = uring->cb;
+uint64_t end = CIRCBUF_SEQ_LOAD(cb->seq_pushed);
+
+	while (uring->submitted < end && uring->inflight < CIRCBUF_URING_DEPTH) {
+
+unsigned index = (uring->first + uring->inflight) % CIRCBUF_URING_DEPTH;
+circstringbuf_write_t *request = &uring->writes[index];
+size_t position = uring->submitted % cb->end;
+size_t size = end - uring->submitted;
+
+		if (size > cb->end - position)
+			size = cb->end - position;
+
+		request->seq = uring->submitted;
+		request->end = uring->submitted + size;
+		request->offset = uring->offset;
+		request->written = false;
+		request->done = false;
+		if (circstringbuf_uring_queue(uring, index) != CIRCBUF_OK)
+			break;
+
+		uring->submitted += size;
+		uring->offset += size;
+		uring->inflight++;
+	}
+}
+
+/*
+ * reap completed writes and submit new ones
+ */
+int
+circstringbuf_uring_drain(circstringbuf_uring_t *uring, bool wait) {
+
+	if (!uring)
+		return CIRCBUF_ERROR;
+
+	if (circstringbuf_uring_reap(uring) != CIRCBUF_OK)
+		return CIRCBUF_ERROR;
+	circstringbuf_uring_submit(uring);
+	if (circstringbuf_uring_enter(uring, wait && uring->pending) != CIRCBUF_OK)
+		return CIRCBUF_ERROR;
+	if (circstringbuf_uring_reap(uring) != CIRCBUF_OK)
+		return CIRCBUF_ERROR;
+
+	if (!uring->inflight &&
+		uring->submitted == CIRCBUF_SEQ_LOAD(uring->cb->seq_pushed))
+		return CIRCBUF_EMPTY;
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * set up io_uring drainer of the buffer
+ */
+int
+circstringbuf_uring_init(circstringbuf_uring_t *uring, circstringbuf_t *cb,
+	int fd, unsigned flags) {
+
+	if (!uring || !cb || fd < 0)
+		return CIRCBUF_ERROR;
+	if (cb->policy != CIRCBUF_DROP_NEWEST && cb->policy != CIRCBUF_BLOCK)
+		return CIRCBUF_ERROR;
+
+off_t offset = lseek(fd, 0, SEEK_CUR);
+struct io_uring_params params;
+
+	memset(uring, 0, sizeof(*uring));
+	memset(&params, 0, sizeof(params));
+
+	/*
+	 * Each write may take two entries with its fsync.
+	 */
+	uring->ring_fd = syscall(__NR_io_uring_setup, 2 * CIRCBUF_URING_DEPTH,
+		&params);
+	if (uring->ring_fd < 0)
+		return CIRCBUF_ERROR;
+
+	uring->sq_ring_size = params.sq_off.array +
+		params.sq_entries * sizeof(unsigned);
+	uring->cq_ring_size = params.cq_off.cqes +
+		params.cq_entries * sizeof(struct io_uring_cqe);
+	uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	uring->sq_ring = mmap(NULL, uring->sq_ring_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQ_RING);
+	uring->cq_ring = mmap(NULL, uring->cq_ring_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_CQ_RING);
+	uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQES);
+	if (uring->sq_ring == MAP_FAILED || uring->cq_ring == MAP_FAILED ||
+		uring->sqes == MAP_FAILED) {
+
+		if (uring->sq_ring != MAP_FAILED)
+			munmap(uring->sq_ring, uring->sq_ring_size);
+		if (uring->cq_ring != MAP_FAILED)
+			munmap(uring->cq_ring, uring->cq_ring_size);
+		if (uring->sqes != MAP_FAILED)
+			munmap(uring->sqes, uring->sqes_size);
+		close(uring->ring_fd);
+
+		return CIRCBUF_ERROR;
+	}
+
+	uring->sq_head = CIRCBUF_URING_AT(uring->sq_ring, params.sq_off.head);
+	uring->sq_tail = CIRCBUF_URING_AT(uring->sq_ring, params.sq_off.tail);
+	uring->sq_mask = CIRCBUF_URING_AT(uring->sq_ring, params.sq_off.ring_mask);
+	uring->sq_array = CIRCBUF_URING_AT(uring->sq_ring, params.sq_off.array);
+	uring->sq_entries = params.sq_entries;
+	uring->cq_head = CIRCBUF_URING_AT(uring->cq_ring, params.cq_off.head);
+	uring->cq_tail = CIRCBUF_URING_AT(uring->cq_ring, params.cq_off.tail);
+	uring->cq_mask = CIRCBUF_URING_AT(uring->cq_ring, params.cq_off.ring_mask);
+	uring->cqes = CIRCBUF_URING_AT(uring->cq_ring, params.cq_off.cqes);
+
+	uring->cb = cb;
+	uring->fd = fd;
+	uring->flags = flags;
+	uring->offset = (offset < 0) ? 0 : offset;
+	uring->submitted = uring->completed = CIRCBUF_SEQ_LOAD(cb->seq_start);
+
+	return CIRCBUF_OK;
+}
+
+/*
+ * wait until everything pushed so far is written, then tear the drainer
+ * down
+ */
+int
+circstringbuf_uring_close(circstringbuf_uring_t *uring) {
+int result;
+
+	if (!uring || !uring->cb)
+		return CIRCBUF_ERROR;
+
+	while ((result = circstringbuf_uring_drain(uring, true)) == CIRCBUF_OK)
+		;
+
+	/*
+	 * Should a write have failed, the rest still in flight, fsyncs
+	 * included, is waited for, so that none of their errors is lost and
+	 * no write lands in the file after the offset is set.
+	 */
+	while (uring->pending) {
+
+		if (circstringbuf_uring_enter(uring, true) != CIRCBUF_OK)
+			break;
+		circstringbuf_uring_reap(uring);
+	}
+	if (uring->pending || uring->error)
+		result = CIRCBUF_ERROR;
+
+	munmap(uring->sqes, uring->sqes_size);
+	munmap(uring->cq_ring, uring->cq_ring_size);
+	munmap(uring->sq_ring, uring->sq_ring_size);
+	close(uring->ring_fd);
+	if (uring->offset && lseek(uring->fd, uring->offset, SEEK_SET) < 0)
+		result = CIRCBUF_ERROR;
+	uring->cb = NULL;
+
+	return (result == CIRCBUF_EMPTY) ? CIRCBUF_OK : CIRCBUF_ERROR;
+}
+#endif /* defined(CIRCBUF_URING) */
@@ -0,0 +1,209 @@
+/*
+ * CircStringBuf -- library implements fast circular buffer for C-style
+ *                  (i.e, '\0'-terminated) strings.
+ *
+ * Copyright © 2019 sven-hm@github
+ * Copyright © 2025 Andrei Kolchugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "circstringbuf.h"
+
+#if !defined(CIRCBUF_URING) && defined(__linux__)
+#	if __has_include(<linux/io_uring.h>)
+#		define CIRCBUF_URING 1
+#	endif /* __has_include(<linux/io_uring.h>) */
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Number of writes the drainer keeps in flight.
+ *
+ */
+#if !defined(CIRCBUF_URING_DEPTH)
+#	define CIRCBUF_URING_DEPTH 8
+#endif
+
+/*
+ * Drainer flags.
+ *
+ * CIRCBUF_URING_FSYNC          - each write is followed by linked
+ *                                fdatasync()
+ *
+ */
+#define CIRCBUF_URING_FSYNC 1
+
+#if defined(CIRCBUF_URING)
+/*
+ * Write in flight.
+ *
+ * @field uint64_t seq          - sequence number of the first buffer byte
+ *                                left to write
+ * @field uint64_t end          - sequence number past the last one
+ * @field uint64_t offset       - file offset to write the first byte to
+ * @field bool written          - data is written
+ * @field bool done             - write is completed, with its fsync if
+ *                                CIRCBUF_URING_FSYNC is set
+ *
+ */
+typedef struct {
+
+	uint64_t seq;
+	uint64_t end;
+	uint64_t offset;
+	bool written;
+	bool done;
+} circstringbuf_write_t;
+
+/*
+ * Asynchronous drainer writing the buffer to the file with io_uring.
+ *
+ * Writes are submitted right from the buffer memory, no more than two
+ * per the data pushed since the previous submission, and the buffer start
+ * is advanced as they complete, oldest first. Being the only consumer of
+ * the buffer, the drainer finds the data by the sequence counters, so it
+ * does not lock the buffer but to advance its start.
+ *
+ * @field circstringbuf_t *cb   - buffer drained (const)
+ * @field int fd                - file written to (const)
+ * @field int ring_fd           - io_uring instance (const)
+ * @field unsigned flags        - CIRCBUF_URING_* flags (const)
+ * @field ...                   - rings mapped, see io_uring_setup(2)
+ * @field uint64_t submitted    - sequence number past the data submitted
+ * @field uint64_t completed    - sequence number past the data written
+ * @field uint64_t offset       - file offset of the next write
+ * @field unsigned first        - the oldest write in flight
+ * @field unsigned inflight     - number of writes in flight
+ * @field unsigned pending      - number of completions expected, writes
+ *                                and fsyncs
+ * @field int error             - the first error, -errno, 0 if none
+ * @field circstringbuf_write_t writes[]
+ *                              - writes in flight
+ *
+ */
+typedef struct {
+
+	circstringbuf_t *cb;
+	int fd;
+	int ring_fd;
+	unsigned flags;
+
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned sq_entries;
+	unsigned sq_queued;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	uint64_t submitted;
+	uint64_t completed;
+	uint64_t offset;
+	unsigned first;
+	unsigned inflight;
+	unsigned pending;
+	int error;
+
+	circstringbuf_write_t writes[CIRCBUF_URING_DEPTH];
+} circstringbuf_uring_t;
+
+/*
+ * set up io_uring drainer of the buffer
+ *
+ * @param circstringbuf_uring_t *uring
+ *                              - static drainer object
+ * @param circstringbuf_t *cb   - buffer to drain
+ * @param int fd                - file to write to, from its current
+ *                                offset on
+ * @param unsigned flags        - CIRCBUF_URING_* flags
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR on error, or if io_uring
+ *                                is not available
+ *
+ * Buffer policy has to be CIRCBUF_DROP_NEWEST or CIRCBUF_BLOCK: data in
+ * flight is still stored in the buffer and must not be evicted. Nor may
+ * the buffer be linearized, resized or allocated contiguously, as these
+ * move the data stored.
+ *
+ * @mt-safety: unsafe
+ *
+ */
+int circstringbuf_uring_init(circstringbuf_uring_t *, circstringbuf_t *,
+	int, unsigned);
+
+/*
+ * reap completed writes and submit new ones
+ *
+ * @param circstringbuf_uring_t *uring
+ *                              - drainer object
+ * @param bool wait             - wait for a write to complete if there is
+ *                                any in flight
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_EMPTY if everything pushed is
+ *                                written, and synced with
+ *                                CIRCBUF_URING_FSYNC
+ *                              - CIRCBUF_ERROR if a write or its fsync
+ *                                has failed, or a write has made no
+ *                                progress, the error is kept in
+ *                                uring->error
+ *
+ * Strings allocated by circstringbuf_malloc() have to be filled up by
+ * the time of the call.
+ *
+ * @mt-safety: unsafe           - one drain thread only, concurrently with
+ *                                any number of producers
+ *
+ */
+int circstringbuf_uring_drain(circstringbuf_uring_t *, bool);
+
+/*
+ * wait until everything pushed so far is written, then tear the drainer
+ * down
+ *
+ * @param circstringbuf_uring_t *uring
+ *                              - drainer object
+ * @return enum                 - CIRCBUF_OK
+ *                              - CIRCBUF_ERROR if a write or its fsync
+ *                                has failed
+ *
+ * Whatever the result, the completions of everything submitted are
+ * waited for before the ring is closed.
+ *
+ * @mt-safety: unsafe
+ *
+ */
+int circstringbuf_uring_close(circstringbuf_uring_t *);
+#endif /* defined(CIRCBUF_URING) */
+
+#if defined(__cplusplus)
+}
+#endif
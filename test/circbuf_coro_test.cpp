@@ -0,0 +1,183 @@
+#include <coroutine>
+#include <cstring>
+#include <exception>
+#include <string>
+#include "unity.h"
+
+#include <circstringbuf.hpp>
+
+#define BUFFER_SIZE (64)
+
+static char buffer[BUFFER_SIZE];
+
+static circstringbuf_t cbuff;
+
+/*
+ * fire-and-forget coroutine
+ */
+struct task {
+
+    struct promise_type {
+
+        task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+static task consume(circstringbuf::buffer &buf, std::string &out, int &done)
+{
+    out = co_await buf.pop();
+    done++;
+}
+
+static task produce(circstringbuf::buffer &buf, const char *string, int &done)
+{
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, co_await buf.reserve(strlen(string) + 1));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, buf.push(string));
+    done++;
+}
+
+static task drain(circstringbuf::buffer &buf, std::string &out, int count,
+        int &done)
+{
+    for (int ii = 0; ii < count; ii++)
+        out = co_await buf.pop();
+    done++;
+}
+
+static std::coroutine_handle<> posted;
+
+static void post(std::coroutine_handle<> handle, void *ctx)
+{
+    (void)ctx;
+    posted = handle;
+}
+
+void setUp(void)
+{
+    circstringbuf_init(&cbuff, buffer, BUFFER_SIZE);
+}
+
+void tearDown(void)
+{
+}
+
+void test_coro_pop(void)
+{
+    circstringbuf::buffer buf(&cbuff);
+    std::string out;
+    int done = 0;
+
+    /* data is there already */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, buf.push("ready"));
+    consume(buf, out, done);
+    TEST_ASSERT_EQUAL(1, done);
+    TEST_ASSERT_EQUAL_STRING("ready", out.c_str());
+
+    /* consumer is resumed inline by push() */
+    consume(buf, out, done);
+    TEST_ASSERT_EQUAL(1, done);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, buf.push("woken"));
+    TEST_ASSERT_EQUAL(2, done);
+    TEST_ASSERT_EQUAL_STRING("woken", out.c_str());
+    TEST_ASSERT_TRUE(cbuff.empty);
+
+    /* consumers are served in order */
+    std::string first, second;
+
+    consume(buf, first, done);
+    consume(buf, second, done);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, buf.push("one"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, buf.push("two"));
+    TEST_ASSERT_EQUAL(4, done);
+    TEST_ASSERT_EQUAL_STRING("one", first.c_str());
+    TEST_ASSERT_EQUAL_STRING("two", second.c_str());
+}
+
+void test_coro_reserve(void)
+{
+    circstringbuf::buffer buf(&cbuff);
+    std::string out;
+    int done = 0;
+
+    circstringbuf_set_policy(&cbuff, CIRCBUF_DROP_NEWEST);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, buf.push(
+                "0123456789012345678901234567890123456789"));
+
+    /* producer waits for the consumer to free up space */
+    produce(buf, "01234567890123456789012345", done);
+    TEST_ASSERT_EQUAL(0, done);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, buf.try_pop(out));
+    TEST_ASSERT_EQUAL(1, done);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, buf.try_pop(out));
+    TEST_ASSERT_EQUAL_STRING("01234567890123456789012345", out.c_str());
+
+    /* space freed by co_await pop() wakes the producer as well, whether
+     * the string is there already or the consumer has been waiting
+     */
+    std::string drained;
+    int drained_done = 0;
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, buf.push(
+                "0123456789012345678901234567890123456789"));
+    produce(buf, "abcdefghijklmnopqrstuvwxyz", done);
+    TEST_ASSERT_EQUAL(1, done);
+    drain(buf, drained, 3, drained_done);
+    TEST_ASSERT_EQUAL(2, done);
+    TEST_ASSERT_EQUAL(0, drained_done);
+    TEST_ASSERT_EQUAL_STRING("abcdefghijklmnopqrstuvwxyz", drained.c_str());
+    produce(buf, "0123456789012345678901234567890123456789", done);
+    produce(buf, "abcdefghijklmnopqrstuvwxyz", done);
+    TEST_ASSERT_EQUAL(4, done);
+    TEST_ASSERT_EQUAL(1, drained_done);
+    TEST_ASSERT_EQUAL_STRING("0123456789012345678901234567890123456789",
+            drained.c_str());
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, buf.try_pop(out));
+    TEST_ASSERT_EQUAL_STRING("abcdefghijklmnopqrstuvwxyz", out.c_str());
+
+    /* size never fitting is not waited for */
+    circstringbuf::buffer::reserve_awaiter awaiter = buf.reserve(
+            BUFFER_SIZE + 1);
+    TEST_ASSERT_TRUE(awaiter.await_ready());
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, awaiter.await_resume());
+}
+
+void test_coro_hook(void)
+{
+    circstringbuf::buffer buf(&cbuff, post, nullptr);
+    std::string out;
+    int done = 0;
+
+    /* hook gets the coroutine with the string already taken for it */
+    consume(buf, out, done);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, buf.push("posted"));
+    TEST_ASSERT_EQUAL(0, done);
+    TEST_ASSERT_TRUE(cbuff.empty);
+    TEST_ASSERT_TRUE(posted);
+    posted.resume();
+    TEST_ASSERT_EQUAL(1, done);
+    TEST_ASSERT_EQUAL_STRING("posted", out.c_str());
+
+    /* data pushed by C functions is delivered by notify() */
+    posted = nullptr;
+    consume(buf, out, done);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "direct"));
+    TEST_ASSERT_FALSE(posted);
+    buf.notify();
+    TEST_ASSERT_TRUE(posted);
+    posted.resume();
+    TEST_ASSERT_EQUAL_STRING("direct", out.c_str());
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_coro_pop);
+    RUN_TEST(test_coro_reserve);
+    RUN_TEST(test_coro_hook);
+
+    return UNITY_END();
+}
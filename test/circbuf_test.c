@@ -4,8 +4,26 @@
 
 #include <stdlib.h>
 #include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 
 #include <circstringbuf.h>
+#include <circstringbuf_shm.h>
+#include <circstringbuf_pool.h>
+#include <circstringbuf_admit.h>
+#include <circstringbuf_spill.h>
+#include <circstringbuf_uring.h>
+#include <circstringbuf_direct.h>
+#include <circstringbuf_stage.h>
+#include <circstringbuf_shard.h>
+#include <circstringbuf_lz.h>
+#include <circstringbuf_dedup.h>
 
 #define BUFFER_SIZE (10240)
 
@@ -286,6 +304,1408 @@ void test_circstringbufrandomstrings_2(void)
     } while (popindex-- > 0);
 }
 
+void test_circstringbufsnapshot(void)
+{
+    circstringbuf_init(&cbuff, buffer, 20);
+    char snap[64];
+    size_t size;
+
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_snapshot(&cbuff, snap,
+                sizeof(snap), &size));
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test1"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test2"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test3"));
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_push(&cbuff, "test4"));
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_snapshot(&cbuff, snap,
+                sizeof(snap), &size));
+    TEST_ASSERT_EQUAL(18, size);
+    TEST_ASSERT_EQUAL_MEMORY("test2\0test3\0test4\0", snap, 18);
+
+    /* only the newest whole strings fit */
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_snapshot(&cbuff, snap,
+                10, &size));
+    TEST_ASSERT_EQUAL(6, size);
+    TEST_ASSERT_EQUAL_STRING("test4", snap);
+
+    /* snapshot does not consume anything */
+    char tmp_buf[10];
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test2", tmp_buf);
+
+    /* space allocated is left out until the next string is pushed */
+    char *part1, *part2;
+    size_t size1 = 6;
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_malloc(&cbuff, &part1,
+                &size1, &part2, 0));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_snapshot(&cbuff, snap,
+                sizeof(snap), &size));
+    TEST_ASSERT_EQUAL(12, size);
+    TEST_ASSERT_EQUAL_MEMORY("test3\0test4\0", snap, 12);
+    memcpy(part1, "test5", size1);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "6"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_snapshot(&cbuff, snap,
+                sizeof(snap), &size));
+    TEST_ASSERT_EQUAL(14, size);
+    TEST_ASSERT_EQUAL_MEMORY("test4\0test5\0" "6", snap, 14);
+}
+
+static volatile bool producer_done;
+
+static void *snapshot_producer(void *arg)
+{
+    char str[64];
+    unsigned int ii;
+
+    (void)arg;
+
+    for (ii = 0; ii < 200000; ii++) {
+        snprintf(str, sizeof(str), "%08u%.*s", ii, (int)(ii % 37),
+                "-------------------------------------");
+        circstringbuf_push(&cbuff, str);
+    }
+    producer_done = true;
+
+    return NULL;
+}
+
+void test_circstringbufsnapshotconcurrent(void)
+{
+    /* Snapshots taken while the producer keeps pushing must always
+     * consist of whole consecutive strings.
+     */
+    circstringbuf_init(&cbuff, buffer, 1000);
+
+    static char snap[1000];
+    pthread_t producer;
+    size_t size;
+
+    producer_done = false;
+    pthread_create(&producer, NULL, snapshot_producer, NULL);
+
+    while (!producer_done) {
+        int retval = circstringbuf_snapshot(&cbuff, snap, sizeof(snap), &size);
+        if (retval == CIRCBUF_EMPTY || retval == CIRCBUF_ERROR)
+            continue;
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, retval);
+
+        size_t pos = 0;
+        long last = -1;
+        while (pos < size) {
+            size_t len = strlen(snap + pos);
+            TEST_ASSERT_TRUE(pos + len < size);
+            unsigned int num = strtoul(snap + pos, NULL, 10);
+            TEST_ASSERT_EQUAL(8 + num % 37, len);
+            TEST_ASSERT_TRUE(last < 0 || num == last + 1);
+            last = num;
+            pos += len + 1;
+        }
+    }
+
+    pthread_join(producer, NULL);
+}
+
+void test_circstringbufdumpfd(void)
+{
+    circstringbuf_init(&cbuff, buffer, 20);
+    char dump[64];
+    int fds[2];
+
+    TEST_ASSERT_EQUAL(0, pipe(fds));
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_dump_fd(&cbuff, fds[1]));
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test1"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test2"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test3"));
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_push(&cbuff, "test4"));
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dump_fd(&cbuff, fds[1]));
+    TEST_ASSERT_EQUAL(18, read(fds[0], dump, sizeof(dump)));
+    TEST_ASSERT_EQUAL_MEMORY("test2\0test3\0test4\0", dump, 18);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_circstringbufdumponsignal(void)
+{
+    circstringbuf_init(&cbuff, buffer, 20);
+    char dump[64];
+    int fds[2];
+    int status;
+
+    TEST_ASSERT_EQUAL(0, pipe(fds));
+
+    pid_t child = fork();
+    if (child == 0) {
+        close(fds[0]);
+        circstringbuf_dump_on_signal(&cbuff, fds[1]);
+        circstringbuf_push(&cbuff, "last");
+        circstringbuf_push(&cbuff, "words");
+        raise(SIGSEGV);
+        _exit(0);
+    }
+    close(fds[1]);
+
+    TEST_ASSERT_EQUAL(11, read(fds[0], dump, sizeof(dump)));
+    TEST_ASSERT_EQUAL_MEMORY("last\0words\0", dump, 11);
+    TEST_ASSERT_EQUAL(child, waitpid(child, &status, 0));
+    TEST_ASSERT_TRUE(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+
+    close(fds[0]);
+}
+
+void test_circstringbufshm(void)
+{
+    /* The same object mapped twice plays producer and consumer processes
+     * seeing the buffer at different addresses.
+     */
+    circstringbuf_shm_t producer, consumer;
+    char name[64];
+    char tmp_buf[10];
+    size_t len;
+
+    snprintf(name, sizeof(name), "/circbuf_test_%d", (int)getpid());
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shm_open(&producer, name,
+                20, true));
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_shm_open(&consumer, name,
+                40, false));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shm_open(&consumer, name,
+                20, false));
+    shm_unlink(name);
+    TEST_ASSERT_TRUE(producer.start != consumer.start);
+
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_shm_pop(&consumer, tmp_buf));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shm_push(&producer, "test1"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shm_push(&producer, "test2"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shm_push(&producer, "test3"));
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_shm_push(&producer, "test4"));
+    TEST_ASSERT_EQUAL(1, consumer.header->dropped);
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shm_strlen(&consumer, &len));
+    TEST_ASSERT_EQUAL(5, len);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shm_pop(&consumer, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test1", tmp_buf);
+
+    /* wraps around the end of the data area */
+    TEST_ASSERT_EQUAL(CIRCBUF_WRAP, circstringbuf_shm_push(&producer, "test5"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shm_pop(&consumer, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test2", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shm_pop(&consumer, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test3", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shm_strlen(&consumer, &len));
+    TEST_ASSERT_EQUAL(5, len);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shm_pop(&consumer, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test5", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_shm_pop(&consumer, tmp_buf));
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shm_close(&consumer));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shm_close(&producer));
+}
+
+void test_circstringbuflinearize(void)
+{
+    circstringbuf_init(&cbuff, buffer, 20);
+    char *str;
+    char tmp_buf[10];
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test1"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test2"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test3"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test4"));
+    TEST_ASSERT_TRUE(cbuff.current_end < cbuff.current_start);
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_linearize(&cbuff));
+    TEST_ASSERT_EQUAL(0, cbuff.current_start);
+    TEST_ASSERT_EQUAL(18, cbuff.current_end);
+    TEST_ASSERT_EQUAL_MEMORY("test2\0test3\0test4\0", buffer, 18);
+
+    /* contiguous allocation has to shift the data down as well */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_malloc_contiguous(&cbuff,
+                &str, 6, CIRCBUF_OK));
+    TEST_ASSERT_EQUAL_PTR(buffer + 12, str);
+    strcpy(str, "test5");
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test3", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test4", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test5", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop(&cbuff, tmp_buf));
+}
+
+void test_circstringbufresize(void)
+{
+    static char bigger[40], smaller[14];
+    char tmp_buf[10];
+
+    circstringbuf_init(&cbuff, buffer, 20);
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test1"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test2"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test3"));
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_push(&cbuff, "test4"));
+
+    /* growing keeps everything */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_resize(&cbuff, bigger,
+                sizeof(bigger)));
+    TEST_ASSERT_EQUAL(0, cbuff.current_start);
+    TEST_ASSERT_EQUAL(18, cbuff.current_end);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test5"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test6"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test2", tmp_buf);
+
+    /* shrinking drops the oldest whole strings */
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_resize(&cbuff, smaller,
+                sizeof(smaller)));
+    TEST_ASSERT_EQUAL(12, cbuff.current_end);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test5", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test6", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop(&cbuff, tmp_buf));
+
+    /* and the buffer keeps working as usual */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test7"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test8"));
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_push(&cbuff, "test9"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test8", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test9", tmp_buf);
+}
+
+void test_circstringbufresizeretries(void)
+{
+    static char bigger[40], smaller[10];
+    char tmp_buf[16];
+
+    circstringbuf_init(&cbuff, buffer, 20);
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test1"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test2"));
+
+    /*
+     * counters seen re-based on every attempt: the lock-free phase gives
+     * up and everything is copied under the lock
+     */
+    cbuff.seq_pushed = cbuff.seq_end + cbuff.end + 1;
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_resize(&cbuff, bigger,
+                sizeof(bigger)));
+    TEST_ASSERT_EQUAL(12, cbuff.current_end);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test1", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test2", tmp_buf);
+
+    /*
+     * no string boundary in the newest bytes copied, on every attempt:
+     * the strings lost are reported
+     */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "ab"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "0123456789"));
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_resize(&cbuff, smaller,
+                sizeof(smaller)));
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop(&cbuff, tmp_buf));
+}
+
+void test_circstringbufsegmented(void)
+{
+    /* Four pages each holding three "stringN" strings, budget of three. */
+    static uint64_t arena[4 * (sizeof(circstringbuf_page_t) + 24) / 8];
+    const size_t page_size = sizeof(circstringbuf_page_t) + 24;
+    circstringbuf_pool_t pool;
+    circstringbuf_seg_t seg1, seg2;
+    char tmp_buf[10];
+    size_t len;
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pool_init(&pool, arena,
+                sizeof(arena), page_size, 3 * page_size));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_init(&seg1, &pool));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_init(&seg2, &pool));
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_seg_pop(&seg1, tmp_buf));
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_seg_push(&seg1,
+                "string longer than the page"));
+
+    /* buffers grow page by page */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_push(&seg1, "string1"));
+    TEST_ASSERT_EQUAL(1, pool.in_use);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_push(&seg2, "string2"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_push(&seg1, "string3"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_push(&seg1, "string4"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_push(&seg1, "string5"));
+    TEST_ASSERT_EQUAL(3, pool.in_use);
+    TEST_ASSERT_EQUAL_PTR(&seg1, pool.buffers);
+    TEST_ASSERT_EQUAL_PTR(&seg2, pool.last);
+
+    /* budget is exhausted, the oldest page of all is evicted */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_push(&seg2, "string6"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_push(&seg2, "string7"));
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_seg_push(&seg2, "string8"));
+    TEST_ASSERT_EQUAL(3, pool.in_use);
+    TEST_ASSERT_EQUAL(3, seg1.dropped);
+    TEST_ASSERT_EQUAL(0, seg2.dropped);
+    TEST_ASSERT_EQUAL_PTR(&seg2, pool.buffers);
+    TEST_ASSERT_EQUAL_PTR(&seg1, pool.last);
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_strlen(&seg1, &len));
+    TEST_ASSERT_EQUAL(7, len);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_pop(&seg1, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("string5", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_seg_pop(&seg1, tmp_buf));
+
+    /* drained pages go back to the pool */
+    TEST_ASSERT_EQUAL(2, pool.in_use);
+    TEST_ASSERT_EQUAL_PTR(&seg2, pool.buffers);
+    TEST_ASSERT_EQUAL_PTR(&seg2, pool.last);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_drop(&seg2));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_pop(&seg2, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("string6", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_pop(&seg2, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("string7", tmp_buf);
+    TEST_ASSERT_EQUAL(1, pool.in_use);
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_release(&seg2));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_seg_release(&seg1));
+    TEST_ASSERT_EQUAL(0, pool.in_use);
+    TEST_ASSERT_NULL(pool.buffers);
+}
+
+static void *policy_consumer(void *arg)
+{
+    char tmp_buf[10];
+
+    usleep(10000);
+    circstringbuf_pop((circstringbuf_t *)arg, tmp_buf);
+
+    return NULL;
+}
+
+void test_circstringbufpolicy(void)
+{
+    char tmp_buf[10];
+    pthread_t consumer;
+
+    circstringbuf_init(&cbuff, buffer, 20);
+
+    /* drop oldest counts evicted strings */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test1"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test2"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test3"));
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_push(&cbuff, "test4"));
+    TEST_ASSERT_EQUAL(1, cbuff.dropped);
+
+    /* drop newest keeps the buffer intact */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_policy(&cbuff,
+                CIRCBUF_DROP_NEWEST));
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_push(&cbuff, "test5"));
+    TEST_ASSERT_EQUAL(2, cbuff.dropped);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test2", tmp_buf);
+
+    /* block waits for the consumer */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test5"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_policy(&cbuff,
+                CIRCBUF_BLOCK));
+    TEST_ASSERT_EQUAL(0, pthread_create(&consumer, NULL, policy_consumer,
+                &cbuff));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test6"));
+    TEST_ASSERT_EQUAL(0, pthread_join(consumer, NULL));
+    TEST_ASSERT_EQUAL(2, cbuff.dropped);
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_set_policy(&cbuff,
+                CIRCBUF_PRIORITY));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test4", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test5", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test6", tmp_buf);
+
+    /* priority evicts the oldest of the lowest priority strings */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_policy(&cbuff,
+                CIRCBUF_PRIORITY));
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_push_prio(&cbuff, "a", 16));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push_prio(&cbuff, "a1", 5));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "b"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push_prio(&cbuff, "c2", 5));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push_prio(&cbuff, "d", 1));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push_prio(&cbuff, "e3", 9));
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_push_prio(&cbuff, "f4", 3));
+    TEST_ASSERT_EQUAL(3, cbuff.dropped);
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_push_prio(&cbuff, "g5", 9));
+    TEST_ASSERT_EQUAL(4, cbuff.dropped);
+
+    /* the string pushed is dropped rather than the higher priority ones */
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_push_prio(&cbuff, "h", 2));
+    TEST_ASSERT_EQUAL(5, cbuff.dropped);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("a1", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("c2", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("e3", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("f4", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("g5", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_policy(&cbuff,
+                CIRCBUF_DROP_OLDEST));
+}
+
+void test_circstringbufadmit(void)
+{
+    circstringbuf_admit_t admit;
+    char tmp_buf[10];
+
+    circstringbuf_init(&cbuff, buffer, 20);
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_admit_init(&admit, 101, 0));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_admit_init(&admit, 50, 2));
+
+    /* below the watermark everything is admitted */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_admit_push(&admit, &cbuff, 0,
+                "test1"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_admit_push(&admit, &cbuff, 0,
+                "test2"));
+    TEST_ASSERT_EQUAL(0, admit.seen);
+
+    /* above it one of two pushes gets through */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_admit_push(&admit, &cbuff, 0,
+                "test3"));
+    TEST_ASSERT_EQUAL(CIRCBUF_REJECTED, circstringbuf_admit_push(&admit,
+                &cbuff, 0, "test4"));
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_admit_push(&admit,
+                &cbuff, 0, "test5"));
+    TEST_ASSERT_EQUAL(1, admit.rejected);
+    TEST_ASSERT_EQUAL(3, admit.seen);
+
+    /* token buckets are kept per producer */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_admit_init(&admit, 50, 0));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_admit_bucket(&admit, 1, 2));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_admit_check(&admit, &cbuff, 1));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_admit_check(&admit, &cbuff, 1));
+    TEST_ASSERT_EQUAL(CIRCBUF_REJECTED, circstringbuf_admit_check(&admit,
+                &cbuff, 1));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_admit_check(&admit, &cbuff, 2));
+    TEST_ASSERT_EQUAL(1, admit.rejected);
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_admit_check(&admit, &cbuff,
+                CIRCBUF_ADMIT_PRODUCERS + 1));
+
+    /* and stop rejecting once the buffer is drained */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_admit_check(&admit, &cbuff, 1));
+}
+
+void test_circstringbufspill(void)
+{
+    static char memory[48];
+    char path[] = "/tmp/circbuf_spill_XXXXXX";
+    circstringbuf_spill_t spill;
+    char tmp_buf[10], expected[10];
+    size_t len;
+    int fd = mkstemp(path);
+
+    TEST_ASSERT_TRUE(fd >= 0);
+    unlink(path);
+
+    circstringbuf_init(&cbuff, buffer, 20);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_spill_init(&spill, fd, memory,
+                sizeof(memory)));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_tier(&cbuff, &spill.tier));
+
+    /* ten strings into the buffer of three, the rest spills */
+    for (int ii = 0; ii < 10; ii++) {
+        sprintf(tmp_buf, "test%d", ii);
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, tmp_buf));
+    }
+    TEST_ASSERT_EQUAL(0, cbuff.dropped);
+    TEST_ASSERT_EQUAL(42, spill.spilled);
+    TEST_ASSERT_EQUAL(24, spill.woff);
+
+    /* strings come back in order: from disk, staged, then from memory */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_strlen(&cbuff, &len));
+    TEST_ASSERT_EQUAL(5, len);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_drop(&cbuff));
+    for (int ii = 1; ii < 8; ii++) {
+        sprintf(expected, "test%d", ii);
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+        TEST_ASSERT_EQUAL_STRING(expected, tmp_buf);
+    }
+
+    /* spilling while being drained keeps the order as well */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "testA"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "testB"));
+    for (int ii = 8; ii < 12; ii++) {
+        sprintf(expected, "test%X", ii);
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+        TEST_ASSERT_EQUAL_STRING(expected, tmp_buf);
+    }
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop(&cbuff, tmp_buf));
+
+    /* the tier splits strings by the delimiter of the buffer, the ones
+     * spilled with another one are refused
+     */
+    for (int ii = 0; ii < 6; ii++) {
+        sprintf(tmp_buf, "test%d", ii);
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, tmp_buf));
+    }
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_tier(&cbuff, NULL));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_reset(&cbuff));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_delimiter(&cbuff, '\n'));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_tier(&cbuff, &spill.tier));
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_strlen(&cbuff, &len));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_delimiter(&cbuff, '\0'));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test0", tmp_buf);
+
+    /* the string cut by a short write is joined with its staged rest,
+     * and the file failing to be read stops popping
+     */
+    struct rlimit limit, short_limit = { 10, RLIM_INFINITY };
+    void (*handler)(int) = signal(SIGXFSZ, SIG_IGN);
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_tier(&cbuff, NULL));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_reset(&cbuff));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_spill_init(&spill, fd, memory,
+                sizeof(memory)));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_tier(&cbuff, &spill.tier));
+    for (int ii = 0; ii < 5; ii++) {
+        sprintf(tmp_buf, "test%d", ii);
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, tmp_buf));
+    }
+    TEST_ASSERT_EQUAL(0, getrlimit(RLIMIT_FSIZE, &limit));
+    short_limit.rlim_max = limit.rlim_max;
+    TEST_ASSERT_EQUAL(0, setrlimit(RLIMIT_FSIZE, &short_limit));
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_spill_flush(&spill));
+    TEST_ASSERT_EQUAL(0, setrlimit(RLIMIT_FSIZE, &limit));
+    signal(SIGXFSZ, handler);
+    TEST_ASSERT_EQUAL(10, spill.woff);
+
+    spill.fd = -1;
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_pop(&cbuff, tmp_buf));
+    spill.fd = fd;
+    for (int ii = 0; ii < 5; ii++) {
+        sprintf(expected, "test%d", ii);
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+        TEST_ASSERT_EQUAL_STRING(expected, tmp_buf);
+    }
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop(&cbuff, tmp_buf));
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_tier(&cbuff, NULL));
+    close(fd);
+}
+
+void test_circstringbufuring(void)
+{
+#if defined(CIRCBUF_URING)
+    char path[] = "/tmp/circbuf_uring_XXXXXX";
+    circstringbuf_uring_t uring;
+    char file_buf[64];
+    int fd = mkstemp(path);
+
+    TEST_ASSERT_TRUE(fd >= 0);
+    unlink(path);
+
+    circstringbuf_init(&cbuff, buffer, 20);
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_uring_init(&uring, &cbuff,
+                fd, 0));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_policy(&cbuff,
+                CIRCBUF_DROP_NEWEST));
+    if (circstringbuf_uring_init(&uring, &cbuff, fd, CIRCBUF_URING_FSYNC)
+            != CIRCBUF_OK) {
+        close(fd);
+        circstringbuf_set_policy(&cbuff, CIRCBUF_DROP_OLDEST);
+        TEST_IGNORE_MESSAGE("io_uring is not available");
+    }
+
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_uring_drain(&uring, true));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test1"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test2"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test3"));
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_push(&cbuff, "test4"));
+
+    /* buffer is released as the writes complete */
+    while (circstringbuf_uring_drain(&uring, true) == CIRCBUF_OK)
+        ;
+    TEST_ASSERT_EQUAL(0, uring.error);
+    TEST_ASSERT_EQUAL(0, uring.pending);
+    TEST_ASSERT_TRUE(cbuff.empty);
+
+    /* data wrapped is written by two writes */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test5"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test6"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_uring_close(&uring));
+    TEST_ASSERT_TRUE(cbuff.empty);
+
+    TEST_ASSERT_EQUAL(30, pread(fd, file_buf, sizeof(file_buf), 0));
+    TEST_ASSERT_EQUAL_MEMORY("test1\0test2\0test3\0test5\0test6\0",
+            file_buf, 30);
+    TEST_ASSERT_EQUAL(30, lseek(fd, 0, SEEK_CUR));
+
+    close(fd);
+
+    /* failed write is reported by close, nothing is left in flight */
+    fd = open("/dev/null", O_RDONLY);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_uring_init(&uring, &cbuff,
+                fd, CIRCBUF_URING_FSYNC));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test7"));
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_uring_close(&uring));
+    TEST_ASSERT_EQUAL(-EBADF, uring.error);
+    TEST_ASSERT_EQUAL(0, uring.pending);
+    TEST_ASSERT_FALSE(cbuff.empty);
+    circstringbuf_reset(&cbuff);
+    close(fd);
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_policy(&cbuff,
+                CIRCBUF_DROP_OLDEST));
+#else /* defined(CIRCBUF_URING) */
+    TEST_IGNORE_MESSAGE("io_uring is not supported");
+#endif /* defined(CIRCBUF_URING) */
+}
+
+void test_circstringbufdirect(void)
+{
+    static char staging[3 * CIRCBUF_DIRECT_BLOCK]
+        __attribute__((aligned(CIRCBUF_DIRECT_BLOCK)));
+    static char file_buf[3 * CIRCBUF_DIRECT_BLOCK];
+    static char string[1000], tmp_buf[1000];
+    char path[] = "/tmp/circbuf_direct_XXXXXX";
+    circstringbuf_direct_reader_t reader;
+    const circstringbuf_direct_header_t *header;
+    uint64_t seq = 0;
+    size_t packed, len;
+    int fd;
+
+    circstringbuf_init(&cbuff, buffer, BUFFER_SIZE);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_direct_pack(&cbuff,
+                staging, 3, &seq, &packed));
+
+    /* the fifth string does not fit the first block and continues */
+    for (int ii = 0; ii < 5; ii++) {
+        memset(string, 'a' + ii, 999);
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, string));
+    }
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "tail"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_direct_pack(&cbuff, staging,
+                3, &seq, &packed));
+    TEST_ASSERT_EQUAL(2, packed);
+    TEST_ASSERT_EQUAL(2, seq);
+    TEST_ASSERT_TRUE(cbuff.empty);
+
+    header = (const void *)staging;
+    TEST_ASSERT_EQUAL(CIRCBUF_DIRECT_PAYLOAD, header->used);
+    TEST_ASSERT_EQUAL(CIRCBUF_DIRECT_CONT_NEXT, header->flags);
+    header = (const void *)(staging + CIRCBUF_DIRECT_BLOCK);
+    TEST_ASSERT_EQUAL(5005 - CIRCBUF_DIRECT_PAYLOAD, header->used);
+    TEST_ASSERT_EQUAL(CIRCBUF_DIRECT_CONT_PREV, header->flags);
+    TEST_ASSERT_EQUAL(1, header->seq);
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_direct_open(&reader, staging,
+                2 * CIRCBUF_DIRECT_BLOCK));
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_direct_read(&reader,
+                tmp_buf, 10, &len));
+    TEST_ASSERT_EQUAL(999, len);
+    for (int ii = 0; ii < 5; ii++) {
+        memset(string, 'a' + ii, 999);
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_direct_read(&reader,
+                    tmp_buf, sizeof(tmp_buf), &len));
+        TEST_ASSERT_EQUAL_STRING(string, tmp_buf);
+    }
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_direct_read(&reader,
+                tmp_buf, sizeof(tmp_buf), NULL));
+    TEST_ASSERT_EQUAL_STRING("tail", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_direct_read(&reader,
+                tmp_buf, sizeof(tmp_buf), NULL));
+
+    /* reading from the second block skips the continuation */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_direct_open(&reader,
+                staging + CIRCBUF_DIRECT_BLOCK, CIRCBUF_DIRECT_BLOCK));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_direct_read(&reader,
+                tmp_buf, sizeof(tmp_buf), NULL));
+    TEST_ASSERT_EQUAL_STRING("tail", tmp_buf);
+
+    /* drained file is read back the same way */
+    fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    unlink(path);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test1"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test2"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_direct_drain(&cbuff, fd,
+                staging, 3, &seq));
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_direct_drain(&cbuff, fd,
+                staging, 3, &seq));
+    TEST_ASSERT_EQUAL(CIRCBUF_DIRECT_BLOCK, pread(fd, file_buf,
+                sizeof(file_buf), 0));
+    close(fd);
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_direct_open(&reader, file_buf,
+                CIRCBUF_DIRECT_BLOCK));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_direct_read(&reader,
+                tmp_buf, sizeof(tmp_buf), NULL));
+    TEST_ASSERT_EQUAL_STRING("test1", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_direct_read(&reader,
+                tmp_buf, sizeof(tmp_buf), NULL));
+    TEST_ASSERT_EQUAL_STRING("test2", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_direct_read(&reader,
+                tmp_buf, sizeof(tmp_buf), NULL));
+
+    /* the string longer than the blocks is reported, not left behind */
+    memset(file_buf, 'x', 5000);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push_n(&cbuff, file_buf,
+                5000));
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_direct_pack(&cbuff,
+                staging, 1, &seq, &packed));
+    TEST_ASSERT_EQUAL(0, packed);
+    fd = open("/dev/null", O_WRONLY);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_direct_drain(&cbuff, fd,
+                staging, 1, &seq));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_direct_drain(&cbuff, fd,
+                staging, 2, &seq));
+    TEST_ASSERT_TRUE(cbuff.empty);
+    close(fd);
+}
+
+void test_circstringbufcreate(void)
+{
+    circstringbuf_t cb;
+    char tmp_buf[10];
+
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_create(&cb, 0,
+                CIRCBUF_NODE_ANY, 0));
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_create(&cb, 1024, 1000, 0));
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_create(&cb, 1024 * 1024,
+                CIRCBUF_NODE_LOCAL, CIRCBUF_HUGEPAGES | CIRCBUF_PREFAULT));
+    TEST_ASSERT_EQUAL(1024 * 1024, cb.end);
+    TEST_ASSERT_TRUE(cb.map_size >= cb.end);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cb, "test1"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cb, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test1", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_destroy(&cb));
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_destroy(&cb));
+
+    /* buffers initialized over the caller's memory are not destroyed */
+    circstringbuf_init(&cbuff, buffer, 20);
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_destroy(&cbuff));
+}
+
+void test_circstringbufstreaming(void)
+{
+    static char string[100], tmp_buf[100];
+
+    circstringbuf_init(&cbuff, buffer, 150);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_streaming(&cbuff, 64));
+
+    /* short strings are copied as usual, long ones are streamed */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "test1"));
+    memset(string, 'a', 99);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, string));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("test1", tmp_buf);
+
+    /* including the ones wrapped */
+    memset(string, 'b', 99);
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_push(&cbuff, string));
+    TEST_ASSERT_TRUE(cbuff.current_end < cbuff.current_start);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING(string, tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop(&cbuff, tmp_buf));
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_streaming(&cbuff, 0));
+}
+
+void test_circstringbufpushpopn(void)
+{
+    char tmp_buf[10];
+    size_t len = 0;
+
+    circstringbuf_init(&cbuff, buffer, 20);
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_push_n(&cbuff,
+                "12345678901234567890", 20));
+
+    /* source need not be terminated */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push_n(&cbuff, "test1XXX", 5));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push_n(&cbuff, "", 0));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push_n(&cbuff, "test23", 6));
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_push_n(&cbuff,
+                "test456", 7));
+
+    /* too small destination is reported with the length needed */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop_n(&cbuff, tmp_buf,
+                sizeof(tmp_buf), &len));
+    TEST_ASSERT_EQUAL(0, len);
+    TEST_ASSERT_EQUAL_STRING("", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_pop_n(&cbuff, tmp_buf, 6,
+                &len));
+    TEST_ASSERT_EQUAL(6, len);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop_n(&cbuff, tmp_buf, 7,
+                &len));
+    TEST_ASSERT_EQUAL_STRING("test23", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop_n(&cbuff, tmp_buf,
+                sizeof(tmp_buf), NULL));
+    TEST_ASSERT_EQUAL_STRING("test456", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop_n(&cbuff, tmp_buf,
+                sizeof(tmp_buf), &len));
+}
+
+void test_circstringbufgroup(void)
+{
+    circstringbuf_txn_t txn;
+    char tmp_buf[20];
+
+    circstringbuf_init(&cbuff, buffer, 20);
+
+    /* group is invisible till committed */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_begin(&cbuff, &txn));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_append(&txn, "aaa"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_append(&txn, "bbb"));
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_commit(&txn));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "cc"));
+
+    /* evicting the first string of the group evicts the whole group */
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_push(&cbuff,
+                "0123456789"));
+    TEST_ASSERT_EQUAL(2, cbuff.dropped);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("cc", tmp_buf);
+
+    /* group evicts older strings to fit */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_begin(&cbuff, &txn));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_append(&txn, "xxxxxxxx"));
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_append(&txn, "yy"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_commit(&txn));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("xxxxxxxx", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("yy", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop(&cbuff, tmp_buf));
+
+    /* group never fitting the buffer */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_begin(&cbuff, &txn));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_append(&txn, "0123456789"));
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_append(&txn,
+                "0123456789"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_abort(&txn));
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop(&cbuff, tmp_buf));
+
+    /* no eviction, nothing appended */
+    circstringbuf_set_policy(&cbuff, CIRCBUF_DROP_NEWEST);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "0123456789"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_begin(&cbuff, &txn));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_append(&txn, "abc"));
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_append(&txn, "defgh"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_abort(&txn));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("0123456789", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop(&cbuff, tmp_buf));
+
+    circstringbuf_set_policy(&cbuff, CIRCBUF_PRIORITY);
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_begin(&cbuff, &txn));
+}
+
+void test_circstringbufstage(void)
+{
+    circstringbuf_stage_t stage;
+    char staging[16];
+    char tmp_buf[40];
+
+    circstringbuf_init(&cbuff, buffer, 40);
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_stage_init(&stage, &cbuff,
+                staging, 41, 0));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_stage_init(&stage, &cbuff,
+                staging, sizeof(staging), 0));
+
+    /* nothing is pushed till the staging memory is full */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_stage_push(&stage, "aaa"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_stage_push(&stage, "bbb"));
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_stage_push(&stage,
+                "cccccccc"));
+    TEST_ASSERT_EQUAL(8, circstringbuf_filllevel(&cbuff) * 40 / 100);
+
+    /* string larger than staging memory goes after the ones staged */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_stage_push(&stage,
+                "dddddddddddddddddddd"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_stage_flush(&stage));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("aaa", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("bbb", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("cccccccc", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("dddddddddddddddddddd", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop(&cbuff, tmp_buf));
+
+    /* block refused is accounted for */
+    circstringbuf_set_policy(&cbuff, CIRCBUF_DROP_NEWEST);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff,
+                "0123456789012345678901234567890"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_stage_push(&stage, "eeee"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_stage_push(&stage, "ffff"));
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_stage_flush(&stage));
+    TEST_ASSERT_EQUAL(2, stage.lost);
+    TEST_ASSERT_EQUAL(2, cbuff.dropped);
+
+    /* timer flushes the strings staged for too long */
+    circstringbuf_reset(&cbuff);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_stage_init(&stage, &cbuff,
+                staging, sizeof(staging), 1));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_stage_push(&stage, "g"));
+    usleep(5000);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_stage_push(&stage, "h"));
+    TEST_ASSERT_EQUAL(0, stage.used);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("g", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("h", tmp_buf);
+}
+
+void test_circstringbufshards(void)
+{
+    circstringbuf_t shard[2];
+    char memory[2][64];
+    circstringbuf_shards_t shards;
+    char tmp_buf[40];
+    size_t len = 0;
+
+    circstringbuf_init(&shard[0], memory[0], sizeof(memory[0]));
+    circstringbuf_init(&shard[1], memory[1], sizeof(memory[1]));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shards_init(&shards, shard, 2,
+                0));
+
+    /* shards are merged in push order */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shards_push_to(&shards, 1,
+                "first"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shards_push_to(&shards, 0,
+                "second"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shards_push_to(&shards, 1,
+                "third"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shards_push(&shards,
+                "fourth"));
+
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_shards_pop(&shards, tmp_buf,
+                5, &len));
+    TEST_ASSERT_EQUAL(5, len);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shards_pop(&shards, tmp_buf,
+                sizeof(tmp_buf), &len));
+    TEST_ASSERT_EQUAL_STRING("first", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shards_pop(&shards, tmp_buf,
+                sizeof(tmp_buf), &len));
+    TEST_ASSERT_EQUAL_STRING("second", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shards_pop(&shards, tmp_buf,
+                sizeof(tmp_buf), &len));
+    TEST_ASSERT_EQUAL_STRING("third", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shards_pop(&shards, tmp_buf,
+                sizeof(tmp_buf), &len));
+    TEST_ASSERT_EQUAL_STRING("fourth", tmp_buf);
+    TEST_ASSERT_EQUAL(6, len);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_shards_pop(&shards,
+                tmp_buf, sizeof(tmp_buf), &len));
+
+    /* young string is held back while the other shard is empty */
+    shards.window = 60000;
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shards_push_to(&shards, 0,
+                "held"));
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_shards_pop(&shards,
+                tmp_buf, sizeof(tmp_buf), &len));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shards_push_to(&shards, 1,
+                "late"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shards_pop(&shards, tmp_buf,
+                sizeof(tmp_buf), &len));
+    TEST_ASSERT_EQUAL_STRING("held", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_shards_pop(&shards,
+                tmp_buf, sizeof(tmp_buf), &len));
+    shards.window = 0;
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shards_pop(&shards, tmp_buf,
+                sizeof(tmp_buf), &len));
+    TEST_ASSERT_EQUAL_STRING("late", tmp_buf);
+
+    /* shard full under CIRCBUF_DROP_NEWEST */
+    circstringbuf_set_policy(&shard[0], CIRCBUF_DROP_NEWEST);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_shards_push_to(&shards, 0,
+                "0123456789012345678901234567890"));
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_shards_push_to(&shards, 0,
+                "0123456789"));
+    TEST_ASSERT_EQUAL(1, shard[0].dropped);
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_shards_push_to(&shards, 2,
+                "x"));
+}
+
+void test_circstringbufdelimiter(void)
+{
+    char tmp_buf[20];
+    char file_buf[40];
+    char *part1, *part2;
+    size_t size1;
+    int fds[2];
+
+    circstringbuf_init(&cbuff, buffer, 20);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_set_delimiter(&cbuff, '\n'));
+
+    /* buffer contents are the text log */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "line1"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push_n(&cbuff, "line2XX", 5));
+    TEST_ASSERT_EQUAL_MEMORY("line1\nline2\n", buffer, 12);
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_set_delimiter(&cbuff,
+                '\0'));
+
+    TEST_ASSERT_EQUAL(0, pipe(fds));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dump_fd(&cbuff, fds[1]));
+    close(fds[1]);
+    TEST_ASSERT_EQUAL(12, read(fds[0], file_buf, sizeof(file_buf)));
+    close(fds[0]);
+    TEST_ASSERT_EQUAL_MEMORY("line1\nline2\n", file_buf, 12);
+
+    /* eviction and popping find the delimiter, callers get C strings */
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_push(&cbuff,
+                "line3456"));
+    TEST_ASSERT_EQUAL(1, cbuff.dropped);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_strlen(&cbuff, &size1));
+    TEST_ASSERT_EQUAL(5, size1);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("line2", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_span(&cbuff, &part1, &size1,
+                &part2));
+    TEST_ASSERT_EQUAL_PTR(buffer, part2);
+    TEST_ASSERT_EQUAL(8, size1);
+    TEST_ASSERT_EQUAL_MEMORY("line3456", part1, 8);
+    TEST_ASSERT_EQUAL_STRING("", part2);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_drop(&cbuff));
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "abcdefghij"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "klm"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_drop(&cbuff));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("klm", tmp_buf);
+
+    /* block pushed has to be delimited the same */
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_push_bulk(&cbuff,
+                "a\0b", 4, 2));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push_bulk(&cbuff, "a\nb\n",
+                4, 2));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("a", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("b", tmp_buf);
+}
+
+void test_circstringbufpeekbulk(void)
+{
+    circstringbuf_segment_t seg1, seg2;
+    char tmp_buf[20];
+    size_t count = 0;
+
+    circstringbuf_init(&cbuff, buffer, 20);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_peek_bulk(&cbuff, 10, 20,
+                &seg1, &seg2, &count));
+    TEST_ASSERT_EQUAL(0, count);
+
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "aaaaaa"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "bbbbbb"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_drop(&cbuff));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "cc"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_push(&cbuff, "dddd"));
+
+    /* limited by the number of strings */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_peek_bulk(&cbuff, 2, 20,
+                &seg1, &seg2, &count));
+    TEST_ASSERT_EQUAL(2, count);
+    TEST_ASSERT_EQUAL_PTR(buffer + 7, seg1.data);
+    TEST_ASSERT_EQUAL(10, seg1.size);
+    TEST_ASSERT_NULL(seg2.data);
+
+    /* limited by bytes, whole strings only; wrapped */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_peek_bulk(&cbuff, 10, 14,
+                &seg1, &seg2, &count));
+    TEST_ASSERT_EQUAL(2, count);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_peek_bulk(&cbuff, 10, 20,
+                &seg1, &seg2, &count));
+    TEST_ASSERT_EQUAL(3, count);
+    TEST_ASSERT_EQUAL(13, seg1.size);
+    TEST_ASSERT_EQUAL_PTR(buffer, seg2.data);
+    TEST_ASSERT_EQUAL(2, seg2.size);
+    TEST_ASSERT_EQUAL_MEMORY("bbbbbb\0cc\0ddd", seg1.data, 13);
+    TEST_ASSERT_EQUAL_MEMORY("d\0", seg2.data, 2);
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_peek_bulk(&cbuff, 10, 6,
+                &seg1, &seg2, &count));
+    TEST_ASSERT_EQUAL(0, count);
+
+    /* nothing is consumed until asked */
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_consume(&cbuff, 4));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_consume(&cbuff, 2));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_pop(&cbuff, tmp_buf));
+    TEST_ASSERT_EQUAL_STRING("dddd", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_consume(&cbuff, 0));
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_consume(&cbuff, 1));
+}
+
+static void *lock_worker(void *arg)
+{
+    unsigned long *sum = arg;
+    char str[16];
+    unsigned int ii;
+
+    for (ii = 0; ii < 20000; ii++) {
+        snprintf(str, sizeof(str), "%u", ii);
+        while (circstringbuf_push(&cbuff, str) != CIRCBUF_OK)
+            ;
+        while (circstringbuf_pop(&cbuff, str) != CIRCBUF_OK)
+            ;
+        *sum += strtoul(str, NULL, 10);
+    }
+
+    return NULL;
+}
+
+void test_circstringbuflock(void)
+{
+    char *part1, *part2;
+    size_t size1;
+
+    circstringbuf_init(&cbuff, buffer, 20);
+
+    /* the span and the allocation stay valid until unlocked */
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_span_guarded(&cbuff,
+                &part1, &size1, &part2));
+    size1 = 4;
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_malloc_guarded(&cbuff,
+                &part1, &size1, &part2, 0));
+    memcpy(part1, "abc", 4);
+    circstringbuf_unlock(&cbuff);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_span_guarded(&cbuff,
+                &part1, &size1, &part2));
+    TEST_ASSERT_EQUAL_STRING("abc", part1);
+    circstringbuf_unlock(&cbuff);
+    circstringbuf_lock(&cbuff);
+    TEST_ASSERT_TRUE(cbuff.empty);
+    circstringbuf_unlock(&cbuff);
+    TEST_ASSERT_TRUE(circstringbuf_filllevel(&cbuff) == 0);
+
+#if defined(CIRCBUF_LOCK) && CIRCBUF_LOCK != CIRCBUF_LOCK_NONE
+    /* every thread gets back as many strings as it pushes, and all of
+     * them are whole
+     */
+    pthread_t threads[4];
+    char tmp_buf[20];
+    unsigned long sums[4] = {0};
+    unsigned long total = 0;
+
+    circstringbuf_init(&cbuff, buffer, 64);
+    circstringbuf_set_policy(&cbuff, CIRCBUF_DROP_NEWEST);
+    for (int ii = 0; ii < 4; ii++)
+        pthread_create(&threads[ii], NULL, lock_worker, &sums[ii]);
+    for (int ii = 0; ii < 4; ii++) {
+        pthread_join(threads[ii], NULL);
+        total += sums[ii];
+    }
+    TEST_ASSERT_EQUAL(4 * (20000UL * 19999 / 2), total);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_pop(&cbuff, tmp_buf));
+#else
+    (void)lock_worker;
+    TEST_IGNORE_MESSAGE("no lock backend");
+#endif
+}
+
+static int lz_visitor(const char *string, size_t len, void *ctx)
+{
+    unsigned int *next = ctx;
+
+    TEST_ASSERT_EQUAL(strlen(string), len);
+    TEST_ASSERT_EQUAL(*next, strtoul(string + 9, NULL, 10));
+    (*next)++;
+
+    return 0;
+}
+
+void test_circstringbuflz(void)
+{
+    static char memory[2048];
+    circstringbuf_lz_t lz;
+    char str[80], tmp_buf[80];
+    unsigned int ii, next = 0;
+    size_t len;
+
+    circstringbuf_init(&cbuff, buffer, BUFFER_SIZE);
+    TEST_ASSERT_TRUE(circstringbuf_lz_size(256) <= sizeof(memory));
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_lz_init(&lz, &cbuff,
+                memory, circstringbuf_lz_size(256) - 1, 256));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_lz_init(&lz, &cbuff,
+                memory, sizeof(memory), 256));
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_lz_pop(&lz, tmp_buf,
+                sizeof(tmp_buf), &len));
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_lz_iterate(&lz,
+                lz_visitor, &next));
+
+    /* repetitive text takes a fraction of its size */
+    for (ii = 0; ii < 500; ii++) {
+        snprintf(str, sizeof(str), "request %05u served path=/api/v1/items"
+                " status=200", ii);
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_lz_push(&lz, str));
+    }
+    TEST_ASSERT_TRUE(lz.stored * 3 < lz.in);
+    TEST_ASSERT_EQUAL(0, lz.lost);
+
+    /* blocks, then the strings staged, in order */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_lz_iterate(&lz,
+                lz_visitor, &next));
+    TEST_ASSERT_EQUAL(500, next);
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_lz_pop(&lz, tmp_buf, 10,
+                &len));
+    TEST_ASSERT_EQUAL(50, len);
+    for (ii = 0; ii < 500; ii++) {
+        snprintf(str, sizeof(str), "request %05u served path=/api/v1/items"
+                " status=200", ii);
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_lz_pop(&lz, tmp_buf,
+                    sizeof(tmp_buf), &len));
+        TEST_ASSERT_EQUAL_STRING(str, tmp_buf);
+    }
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_lz_pop(&lz, tmp_buf,
+                sizeof(tmp_buf), &len));
+
+    /* the oldest blocks are evicted whole, under any delimiter; random
+     * strings do not compress and still come back intact
+     */
+    circstringbuf_init(&cbuff, buffer, 1024);
+    circstringbuf_set_delimiter(&cbuff, '\n');
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_lz_init(&lz, &cbuff,
+                memory, sizeof(memory), 256));
+    srand(7);
+    for (ii = 0; ii < 200; ii++) {
+        snprintf(str, sizeof(str), "request %05u %08x%08x", ii, rand(),
+                rand());
+        circstringbuf_lz_push(&lz, str);
+    }
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_lz_seal(&lz));
+    TEST_ASSERT_EQUAL(0, lz.lost);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_lz_pop(&lz, tmp_buf,
+                sizeof(tmp_buf), &len));
+    next = strtoul(tmp_buf + 8, NULL, 10);
+    TEST_ASSERT_TRUE(next > 0);
+    TEST_ASSERT_EQUAL(0, next % (256 / 31));
+    for (ii = next + 1; ii < 200; ii++) {
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_lz_pop(&lz, tmp_buf,
+                    sizeof(tmp_buf), &len));
+        TEST_ASSERT_EQUAL(ii, strtoul(tmp_buf + 8, NULL, 10));
+        TEST_ASSERT_EQUAL(30, len);
+    }
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_lz_pop(&lz, tmp_buf,
+                sizeof(tmp_buf), &len));
+}
+
+void test_circstringbufdedup(void)
+{
+    static uint64_t memory[256];
+    const char *check = "health check ok from 10.0.0.1";
+    const char *retry = "retrying request to upstream";
+    static const circstringbuf_tier_t tier;
+    circstringbuf_dedup_t dd;
+    char tmp_buf[64];
+    char *part1, *part2;
+    size_t size1, len;
+    unsigned int ii;
+
+    circstringbuf_init(&cbuff, buffer, BUFFER_SIZE);
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_dedup_init(&dd, &cbuff,
+                memory, sizeof(memory), 6, 48));
+
+    /* back-references evicted to the tier would outlive their slots */
+    cbuff.tier = &tier;
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_dedup_init(&dd, &cbuff,
+                memory, sizeof(memory), 16, 48));
+    cbuff.tier = NULL;
+    TEST_ASSERT_TRUE(circstringbuf_dedup_size(16, 48) <= sizeof(memory));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_init(&dd, &cbuff,
+                memory, sizeof(memory), 16, 48));
+    TEST_ASSERT_EQUAL(CIRCBUF_ERROR, circstringbuf_dedup_push(&dd,
+                "\x1e" "000000000001"));
+
+    /* the zero counter is no back-reference */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_push(&dd,
+                "\x1e" "000000000000"));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_pop(&dd, tmp_buf,
+                sizeof(tmp_buf), &len));
+    TEST_ASSERT_EQUAL_STRING("\x1e" "000000000000", tmp_buf);
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_dedup_pop(&dd, tmp_buf,
+                sizeof(tmp_buf), &len));
+    circstringbuf_init(&cbuff, buffer, BUFFER_SIZE);
+
+    /* consecutive repeats are counted in place */
+    for (ii = 0; ii < 100; ii++)
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_push(&dd, check));
+    TEST_ASSERT_EQUAL(99, dd.hits);
+    TEST_ASSERT_EQUAL(strlen(check) + 1 + CIRCBUF_DEDUP_REFLEN + 1,
+            cbuff.seq_end);
+
+    /* interleaved ones are referenced */
+    for (ii = 0; ii < 4; ii++) {
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_push(&dd, retry));
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_push(&dd, "short"));
+    }
+    TEST_ASSERT_EQUAL(CIRCBUF_FULL, circstringbuf_dedup_pop(&dd, tmp_buf, 8,
+                &len));
+    TEST_ASSERT_EQUAL(strlen(check), len);
+    for (ii = 0; ii < 100; ii++) {
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_pop(&dd, tmp_buf,
+                    sizeof(tmp_buf), &len));
+        TEST_ASSERT_EQUAL_STRING(check, tmp_buf);
+    }
+    for (ii = 0; ii < 4; ii++) {
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_span(&dd, &part1,
+                    &size1, &part2));
+        TEST_ASSERT_EQUAL_STRING(retry, part1);
+        TEST_ASSERT_NULL(part2);
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_pop(&dd, tmp_buf,
+                    sizeof(tmp_buf), &len));
+        TEST_ASSERT_EQUAL_STRING("short", tmp_buf);
+    }
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_dedup_pop(&dd, tmp_buf,
+                sizeof(tmp_buf), &len));
+
+    /* the original evicted, its back-references still resolve, and the
+     * slot referenced is not reused meanwhile
+     */
+    circstringbuf_init(&cbuff, buffer, 80);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_init(&dd, &cbuff,
+                memory, sizeof(memory), 1, 48));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_push(&dd, check));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_push(&dd, check));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_push(&dd, retry));
+    TEST_ASSERT_EQUAL(CIRCBUF_DATALOSS, circstringbuf_dedup_push(&dd, retry));
+    TEST_ASSERT_EQUAL(1, dd.hits);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_pop(&dd, tmp_buf,
+                sizeof(tmp_buf), &len));
+    TEST_ASSERT_EQUAL_STRING(check, tmp_buf);
+    for (ii = 0; ii < 2; ii++) {
+        TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_pop(&dd, tmp_buf,
+                    sizeof(tmp_buf), &len));
+        TEST_ASSERT_EQUAL_STRING(retry, tmp_buf);
+    }
+    TEST_ASSERT_EQUAL(CIRCBUF_EMPTY, circstringbuf_dedup_pop(&dd, tmp_buf,
+                sizeof(tmp_buf), &len));
+
+    /* nothing refers to the slot now */
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_push(&dd, retry));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_push(&dd, retry));
+    TEST_ASSERT_EQUAL(2, dd.hits);
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_pop(&dd, tmp_buf,
+                sizeof(tmp_buf), &len));
+    TEST_ASSERT_EQUAL(CIRCBUF_OK, circstringbuf_dedup_pop(&dd, tmp_buf,
+                sizeof(tmp_buf), &len));
+    TEST_ASSERT_EQUAL_STRING(retry, tmp_buf);
+}
+
 int main(void) {
     UNITY_BEGIN();
 
@@ -296,6 +1716,31 @@ int main(void) {
     RUN_TEST(test_circstringbufstuff);
     RUN_TEST(test_circstringbufrandomstrings_1);
     RUN_TEST(test_circstringbufrandomstrings_2);
+    RUN_TEST(test_circstringbufsnapshot);
+    RUN_TEST(test_circstringbufsnapshotconcurrent);
+    RUN_TEST(test_circstringbufdumpfd);
+    RUN_TEST(test_circstringbufdumponsignal);
+    RUN_TEST(test_circstringbufshm);
+    RUN_TEST(test_circstringbuflinearize);
+    RUN_TEST(test_circstringbufresize);
+    RUN_TEST(test_circstringbufresizeretries);
+    RUN_TEST(test_circstringbufsegmented);
+    RUN_TEST(test_circstringbufpolicy);
+    RUN_TEST(test_circstringbufadmit);
+    RUN_TEST(test_circstringbufspill);
+    RUN_TEST(test_circstringbufuring);
+    RUN_TEST(test_circstringbufdirect);
+    RUN_TEST(test_circstringbufcreate);
+    RUN_TEST(test_circstringbufstreaming);
+    RUN_TEST(test_circstringbufpushpopn);
+    RUN_TEST(test_circstringbufgroup);
+    RUN_TEST(test_circstringbufstage);
+    RUN_TEST(test_circstringbufshards);
+    RUN_TEST(test_circstringbufdelimiter);
+    RUN_TEST(test_circstringbufpeekbulk);
+    RUN_TEST(test_circstringbuflock);
+    RUN_TEST(test_circstringbuflz);
+    RUN_TEST(test_circstringbufdedup);
 
-    UNITY_END();
+    return UNITY_END();
 }